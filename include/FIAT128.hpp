@@ -3,8 +3,11 @@
 #include <algorithm>
 #include <array>
 #include <assert.h>
+#include <atomic>
+#include <bit>
 #include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <chrono>
 #include <deque>
 #include <filesystem>
@@ -12,10 +15,12 @@
 #include <future>
 #include <iostream>
 #include <limits>
+#include <list>
 #include <map>
 #include <math.h>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <numbers>
 #include <optional>
 #include <queue>
@@ -58,6 +63,9 @@ inline const std::string BINARY_DIRECTORY = std::filesystem::current_path().stri
 
 #else
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // inline const std::string BINARY_DIRECTORY_TEST(std::string(get_current_dir_name()) + "/");
@@ -179,6 +187,14 @@ namespace FIAT128
         return std::is_base_of<Base, T>::value;
     }
 
+    /**
+     * @brief Words of at most 64 bits fit a machine register, the ALU and decoder use it instead of walking bits
+     *
+     * @tparam bits The word width
+     */
+    template <size_t bits>
+    inline constexpr bool fits_native_word = bits <= 64;
+
     /**
      * @brief lamda to check if a number is a power of 2
      *
@@ -236,6 +252,404 @@ namespace FIAT128
 
     };
 
+    /**
+     * @brief Minimal allocator handing out storage aligned to a cache line
+     */
+    template <typename T, size_t Alignment = 64>
+    struct AlignedAllocator
+    {
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() noexcept = default;
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+        auto allocate(size_t count) -> T *
+        {
+            return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+        }
+
+        auto deallocate(T *pointer, size_t) noexcept -> void
+        {
+            ::operator delete(pointer, std::align_val_t{Alignment});
+        }
+
+        friend auto operator==(const AlignedAllocator &, const AlignedAllocator &) noexcept -> bool { return true; }
+        friend auto operator!=(const AlignedAllocator &, const AlignedAllocator &) noexcept -> bool { return false; }
+    };
+
+    /**
+     * @brief Bounded multi-producer ring indexed by sequence number
+     *
+     * @note producers claim a sequence with one fetch_add and publish through a per-slot seqlock stamp
+     *       (odd while writing, even when published), so readers never block writers. Payloads are stored
+     *       as relaxed atomic 64-bit words, T must be trivially copyable. The capacity is rounded up to a
+     *       power of two.
+     */
+    template <typename T>
+    struct AtomicRing
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "AtomicRing payloads must be trivially copyable");
+
+        explicit AtomicRing(size_t requested_capacity)
+            : mask(round_up_to_power_of_two(requested_capacity) - 1), slots(std::make_unique<Slot[]>(mask + 1)) {}
+
+        auto capacity() const -> size_t
+        {
+            return mask + 1;
+        }
+
+        /**
+         * @brief Reserves the next sequence number, sequences start at 1
+         */
+        auto claim() -> uint64_t
+        {
+            return head.fetch_add(1, std::memory_order_acq_rel) + 1;
+        }
+
+        /**
+         * @brief Publishes the payload for a claimed sequence
+         *
+         * @note a producer that was lapped by a newer one drops its payload and counts it as dropped
+         */
+        auto publish(uint64_t sequence, const T &value) -> void
+        {
+            auto &slot = slots[sequence & mask];
+            const uint64_t writing = sequence * 2 - 1;
+
+            uint64_t expected = slot.stamp.load(std::memory_order_relaxed);
+            for (size_t attempt = 0;; ++attempt)
+            {
+                if (expected > writing)
+                {
+                    dropped_count.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                if (!(expected & 1U) && slot.stamp.compare_exchange_weak(expected, writing, std::memory_order_acquire, std::memory_order_relaxed))
+                    break;
+
+                // another producer is still writing the slot, give it the core instead of spinning on the stamp
+                if (attempt >= publish_spin_attempts)
+                    std::this_thread::yield();
+                expected = slot.stamp.load(std::memory_order_relaxed);
+            }
+
+            // the odd stamp has to be visible before any payload word, the writer half of the seqlock
+            std::atomic_thread_fence(std::memory_order_release);
+
+            // the stamp is the published entry this one replaces, which can be older than one lap when the producer of
+            // the entry in between is still behind. count it unless a reader already collected it
+            const uint64_t replaced = expected / 2;
+            if (replaced > 0 && replaced > collected.load(std::memory_order_relaxed))
+                overwritten_count.fetch_add(1, std::memory_order_relaxed);
+
+            std::array<uint64_t, payload_words> words{};
+            std::memcpy(words.data(), &value, sizeof(T));
+            for (size_t i = 0; i < payload_words; ++i)
+                slot.payload[i].store(words[i], std::memory_order_relaxed);
+
+            slot.stamp.store(sequence * 2, std::memory_order_release);
+        }
+
+        auto push(const T &value) -> uint64_t
+        {
+            const uint64_t sequence = claim();
+            publish(sequence, value);
+            return sequence;
+        }
+
+        /**
+         * @brief Copies out the payload for sequence if it is published and still in the ring
+         */
+        auto try_read(uint64_t sequence, T &value) const -> bool
+        {
+            const auto &slot = slots[sequence & mask];
+            const uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+            if (stamp != sequence * 2)
+                return false;
+
+            std::array<uint64_t, payload_words> words{};
+            for (size_t i = 0; i < payload_words; ++i)
+                words[i] = slot.payload[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.stamp.load(std::memory_order_relaxed) != stamp)
+                return false;
+
+            std::memcpy(static_cast<void *>(&value), words.data(), sizeof(T));
+            return true;
+        }
+
+        /**
+         * @brief Appends every published entry after last_sequence, oldest first, and returns the new cursor
+         *
+         * @note seeks straight to the oldest sequence still in the ring and stops at the first entry that is
+         *       still being written, so a later call picks it up. skipped counts entries after last_sequence
+         *       that were overwritten before this call could read them.
+         */
+        auto collect_since(uint64_t last_sequence, std::vector<T> &values, uint64_t &skipped) const -> uint64_t
+        {
+            const uint64_t newest = head.load(std::memory_order_acquire);
+            const uint64_t oldest = newest > mask ? newest - mask : 1;
+            uint64_t sequence = std::max<uint64_t>(last_sequence + 1, oldest);
+            skipped = sequence - (last_sequence + 1);
+
+            for (T value; sequence <= newest; ++sequence)
+            {
+                if (try_read(sequence, value))
+                {
+                    values.push_back(value);
+                    continue;
+                }
+
+                if (slots[sequence & mask].stamp.load(std::memory_order_acquire) < sequence * 2)
+                    break;
+
+                ++skipped;
+            }
+
+            uint64_t seen = collected.load(std::memory_order_relaxed);
+            while (seen < sequence - 1 && !collected.compare_exchange_weak(seen, sequence - 1, std::memory_order_relaxed))
+            {
+            }
+
+            return sequence - 1;
+        }
+
+        auto collect_since(uint64_t last_sequence, std::vector<T> &values) const -> uint64_t
+        {
+            uint64_t skipped = 0;
+            return collect_since(last_sequence, values, skipped);
+        }
+
+        auto latest() const -> uint64_t
+        {
+            return head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Entries lost before any reader saw them, overwritten before collect_since reached them or dropped
+         *        by a lapped producer
+         *
+         * @note written for a single reader, the ring only remembers the furthest cursor any collect_since reached.
+         *       With several readers each one counts its own losses through the skipped out-parameter of collect_since.
+         */
+        auto dropped() const -> uint64_t
+        {
+            return overwritten_count.load(std::memory_order_relaxed) + lapped();
+        }
+
+        auto lapped() const -> uint64_t
+        {
+            return dropped_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr size_t payload_words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        static constexpr size_t publish_spin_attempts = 16;
+
+        static auto round_up_to_power_of_two(size_t value) -> size_t
+        {
+            size_t power = 1;
+            while (power < value)
+                power <<= 1;
+
+            return power;
+        }
+
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> stamp{0};
+            std::array<std::atomic<uint64_t>, payload_words> payload{};
+        };
+
+        size_t mask = 0;
+        std::unique_ptr<Slot[]> slots;
+        alignas(64) std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> dropped_count{0};
+        std::atomic<uint64_t> overwritten_count{0};
+        // highest sequence any collect_since returned, shared by every reader, readers are const so it is mutable
+        mutable std::atomic<uint64_t> collected{0};
+    };
+
+    /**
+     * @brief Read-only memory mapping of a ROM image file
+     *
+     * @note an image holds whole words as host-order uint64_t limbs, lowest limb first, the layout written by
+     *       Emulator::save_rom_image. One image can back modules in any number of emulators at once.
+     */
+    struct RomImage
+    {
+        /**
+         * @brief Maps the file at path, returns nullptr when it is missing, empty or cannot be mapped
+         */
+        static auto open(const std::filesystem::path &path) -> std::shared_ptr<const RomImage>
+        {
+            std::shared_ptr<RomImage> image(new RomImage());
+
+#ifdef _WIN32
+            image->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (image->file == INVALID_HANDLE_VALUE)
+                return nullptr;
+
+            LARGE_INTEGER file_size{};
+            if (!GetFileSizeEx(image->file, &file_size) || file_size.QuadPart <= 0)
+                return nullptr;
+
+            image->mapping = CreateFileMappingW(image->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!image->mapping)
+                return nullptr;
+
+            image->mapped = static_cast<const uint8_t *>(MapViewOfFile(image->mapping, FILE_MAP_READ, 0, 0, 0));
+            if (!image->mapped)
+                return nullptr;
+
+            image->bytes = static_cast<size_t>(file_size.QuadPart);
+#else
+            const int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0)
+                return nullptr;
+
+            struct stat status{};
+            if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+            {
+                close(descriptor);
+                return nullptr;
+            }
+
+            void *mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            close(descriptor);
+            if (mapped == MAP_FAILED)
+                return nullptr;
+
+            image->mapped = static_cast<const uint8_t *>(mapped);
+            image->bytes = static_cast<size_t>(status.st_size);
+#endif
+
+            return image;
+        }
+
+        RomImage(const RomImage &) = delete;
+        RomImage &operator=(const RomImage &) = delete;
+
+        ~RomImage()
+        {
+#ifdef _WIN32
+            if (mapped)
+                UnmapViewOfFile(mapped);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (mapped)
+                munmap(const_cast<uint8_t *>(mapped), bytes);
+#endif
+        }
+
+        auto data() const -> const uint8_t *
+        {
+            return mapped;
+        }
+
+        auto size() const -> size_t
+        {
+            return bytes;
+        }
+
+    private:
+        RomImage() = default;
+
+        const uint8_t *mapped = nullptr;
+        size_t bytes = 0;
+
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+    };
+
+    /**
+     * @brief What a memory write subscriber wants to see
+     *
+     * @note bit n of channels selects memory module n and bit n of cpus selects CPU n, range writes match when
+     *       any word of the range falls inside [first_index, last_index]
+     */
+    struct MemoryWriteFilter
+    {
+        uint64_t channels = ~0ULL;
+        size_t first_index = 0;
+        size_t last_index = std::numeric_limits<size_t>::max();
+        uint64_t cpus = ~0ULL;
+
+        auto matches(size_t cpu_id, size_t channel, size_t index, size_t count) const -> bool
+        {
+            return channel < 64 && ((channels >> channel) & 1U) &&
+                   cpu_id < 64 && ((cpus >> cpu_id) & 1U) &&
+                   index <= last_index && index + count > first_index;
+        }
+    };
+
+    enum class WatchAccess : uint8_t
+    {
+        Read = 1,
+        Write = 2,
+        ReadWrite = 3,
+    };
+
+    /**
+     * @brief An inclusive address range on one memory channel to trace
+     */
+    struct Watchpoint
+    {
+        size_t channel = 0;
+        size_t first_index = 0;
+        size_t last_index = std::numeric_limits<size_t>::max();
+        WatchAccess access = WatchAccess::Write;
+    };
+
+    // 0 is never handed out
+    using WatchpointId = uint64_t;
+
+    /**
+     * @brief One access that hit an armed watchpoint, pc is the accessing CPU's stack pointer
+     */
+    struct WatchHit
+    {
+        WatchpointId watchpoint = 0;
+        size_t cpu_id = 0;
+        size_t pc = 0;
+        uint64_t cycle = 0;
+        size_t channel = 0;
+        size_t index = 0;
+        size_t count = 1;
+        WatchAccess access = WatchAccess::Write;
+    };
+
+    enum class WriteDropPolicy : uint8_t
+    {
+        DropOldest, // a full queue overwrites its oldest entry
+        DropNewest, // a full queue rejects new entries until it is polled
+    };
+
+    // 0 is never handed out, tokens are unique across every emulator in the process
+    using MemoryWriteSubscription = uint64_t;
+
+    enum class GpuPixelFormat : uint8_t
+    {
+        Argb8888 = 0,
+        Rgb565 = 1,
+        Indexed8 = 2,
+    };
+
     enum class InstructionAccess
     {
         CacheOnly,
@@ -284,7 +698,12 @@ namespace FIAT128
             bus = BUS(memory, cpus);
 
             for (size_t i = 0; i <= cores; i++)
+            {
                 cpus[i].set_bus(&bus);
+                bus.set_core_active(i, !cpus[i].is_halted());
+            }
+
+            attach_builtin_devices();
         }
 
         Emulator(const std::array<size_t, memory_modules> &memory_sizes)
@@ -295,72 +714,282 @@ namespace FIAT128
             bus = BUS(memory, cpus);
 
             for (size_t i = 0; i <= cores; i++)
+            {
                 cpus[i].set_bus(&bus);
+                bus.set_core_active(i, !cpus[i].is_halted());
+            }
+
+            attach_builtin_devices();
         }
 
+        /**
+         * @brief Advances every running core by one cycle in step mode, otherwise by one whole instruction
+         */
         auto run(bool step_mode = false)
         {
-            for (auto &cpu : cpus)
+            if (is_idle()) [[unlikely]]
+                return;
+
+            for (size_t i = 0; i <= cores; i++)
             {
-                cpu.execute_instruction(step_mode);
+                if (bus.active_cores.test(i))
+                    cpus[i].execute_instruction(step_mode);
             }
 
+            service_dma();
             execute_gpu_shader();
         }
 
         /**
-         * @brief Set the word on the given memory channel and index
-         *
-         * @param channel
-         * @param index
-         * @param value
-         *
-         * @note is thread safe
+         * @brief Calls run() up to steps times and returns how many ran, stops early once the machine is idle
          */
-        auto set_word_in_memory(size_t channel, size_t index, std::bitset<word_size> value)
+        auto run_steps(size_t steps, bool step_mode = false) -> size_t
         {
-            bus.write(true, 0, channel, index, value);
+            // 0 outside step mode when instructions differ in length, nothing parks then
+            const uint64_t cycles_per_step = step_mode ? 1 : CPU::cycles_per_instruction();
+
+            for (size_t step = 0; step < steps; step++)
+            {
+                if (is_idle())
+                    return step;
+
+                // when every live core is parked the steps until the first one resumes only move counters
+                const uint64_t parked_steps = cycles_per_step ? parked_cycles_available() / cycles_per_step : 0;
+                if (parked_steps > 1)
+                {
+                    const size_t skipped = static_cast<size_t>(std::min<uint64_t>(parked_steps - 1, steps - step));
+                    for (size_t i = 0; i <= cores; i++)
+                    {
+                        if (bus.active_cores.test(i))
+                            cpus[i].skip_parked_cycles(skipped * cycles_per_step);
+                    }
+
+                    step += skipped - 1;
+                    continue;
+                }
+
+                run(step_mode);
+            }
+
+            return steps;
         }
 
         /**
-         * @brief Set the instruction on the given memory channel and index
-         *
-         * @param channel
-         * @param index
-         * @param value
+         * @brief Runs whole instructions until the busiest core has advanced by cycles, returns the cycles that ran
          *
-         * @note is thread safe
+         * @note the last instruction, or fused pair, can run past the budget and callers pacing a clock carry the
+         *       difference. Stops early once the machine is idle
          */
-        auto set_instruction_in_memory(size_t channel, size_t index, InstructionType type, RegisterIndex dest, RegisterIndex src_1 = RegisterIndex::R0, RegisterIndex src_2 = RegisterIndex::R0)
+        auto run_cycles(uint64_t cycles) -> uint64_t
         {
-            unsigned char instruction[4] = {to_uchar(type), to_uchar(dest), to_uchar(src_1), to_uchar(src_2)};
-            bus.write(true, 0, channel, index, instruction);
-        }
+            uint64_t ran = 0;
+            std::array<long long, cores + 1> before{};
 
-        auto set_instruction_in_cpu(char cpu_id, short index, InstructionType type, RegisterIndex dest, RegisterIndex src_1 = RegisterIndex::R0, RegisterIndex src_2 = RegisterIndex::R0)
-        {
-            if (to_size_t(cpu_id) <= cores)
-                cpus[to_size_t(cpu_id)].add_instruction(index, type, dest, src_1, src_2);
+            while (ran < cycles && !is_idle())
+            {
+                for (size_t i = 0; i <= cores; i++)
+                    before[i] = cpus[i].total_cpu_cycles;
+
+                run(false);
+
+                // load_timer() restarts the counter, such a call still counts as one cycle
+                long long advanced = 1;
+                for (size_t i = 0; i <= cores; i++)
+                    advanced = std::max(advanced, cpus[i].total_cpu_cycles - before[i]);
+                ran += static_cast<uint64_t>(advanced);
+            }
+
+            return ran;
         }
 
-        auto set_memory_instruction_in_memory(size_t channel, size_t index, InstructionType type, RegisterIndex reg, unsigned char module, unsigned short address) -> void
+        /**
+         * @brief Lets cores skip the iterations of simple counted register loops in closed form
+         *
+         * @note off by default. Registers, flags, cycles and the timer end up as if the iterations had been stepped,
+         *       but the core gets ahead of the others by the skipped cycles within a single run() call. A core that a
+         *       requested or running DMA transfer will interrupt keeps stepping until the transfer is done
+         */
+        auto set_loop_acceleration(bool enabled) -> void
         {
-            const auto packed_operand = static_cast<unsigned char>((to_uchar(reg) << 4) | (module & 0x0F));
-            std::bitset<word_size> encoded(u32(type) << 24 | u32(packed_operand) << 16 | u32(address));
-            encoded <<= (word_size - 32);
-            bus.write(true, 0, channel, index, encoded);
+            for (size_t i = 0; i <= cores; i++)
+                cpus[i].accelerate_loops = enabled;
         }
 
-        auto set_memory_instruction_in_cpu(char cpu_id, short index, InstructionType type, RegisterIndex reg, unsigned char module, unsigned short address) -> void
+        /**
+         * @brief Lets cores park in side-effect free polling loops until a word they read or their cache is written
+         *
+         * @note off by default. A parked core keeps counting cycles and the timer as if it stepped the loop, and
+         *       run_steps skips the steps in which every live core is parked. Turning it off stops new parks, a core
+         *       that is already parked still resumes on the write it waits for
+         */
+        auto set_core_parking(bool enabled) -> void
         {
-            if (to_size_t(cpu_id) <= cores)
-                cpus[to_size_t(cpu_id)].add_memory_instruction(index, type, reg, module, address);
+            for (size_t i = 0; i <= cores; i++)
+                cpus[i].park_spinning = enabled;
         }
 
-        auto set_word_in_cpu(char cpu_id, short index, std::bitset<word_size> value)
+        /**
+         * @brief Lets cores run compare-and-branch, add-and-test and memory-to-memory move pairs as one dispatch
+         *
+         * @note off by default and only used outside step mode. Both halves are charged the cycles they take on their
+         *       own, but the core gets ahead of the others by the second half within a single run() call. A pair is
+         *       split again when an interrupt, a timer expiry or a DMA completion could land between the halves
+         */
+        auto set_instruction_fusion(bool enabled) -> void
         {
-            if (to_size_t(cpu_id) <= cores)
-                cpus[to_size_t(cpu_id)].add_word(index, value);
+            for (size_t i = 0; i <= cores; i++)
+                cpus[i].fuse_instructions = enabled;
+        }
+
+        /**
+         * @brief Cycles every live core can stay parked for, 0 when one of them is running or devices have work
+         */
+        auto parked_cycles_available() const -> uint64_t
+        {
+            if (has_pending_gpu_command() || (dma_device && (dma_transfer.active || dma_device->doorbell.load(std::memory_order_acquire))))
+                return 0;
+
+            uint64_t available = std::numeric_limits<uint64_t>::max();
+            for (size_t i = 0; i <= cores; i++)
+            {
+                if (bus.active_cores.test(i))
+                    available = std::min(available, cpus[i].parked_cycles_available());
+            }
+
+            return available;
+        }
+
+        /**
+         * @brief True when every core is halted and neither the GPU nor the DMA controller has work pending
+         */
+        auto is_idle() const -> bool
+        {
+            return bus.active_cores.none() && !has_pending_gpu_command() &&
+                   !(dma_device && (dma_transfer.active || dma_device->doorbell.load(std::memory_order_acquire)));
+        }
+
+        /**
+         * @brief Set the word on the given memory channel and index
+         *
+         * @param channel
+         * @param index
+         * @param value
+         *
+         * @note is thread safe
+         */
+        auto set_word_in_memory(size_t channel, size_t index, std::bitset<word_size> value)
+        {
+            bus.write(true, 0, channel, index, value);
+        }
+
+        /**
+         * @brief Read up to count consecutive words, clipped to the module size
+         *
+         * @note is thread safe, takes the module lock once
+         */
+        auto read_range(size_t channel, size_t first, size_t count) -> std::vector<std::bitset<word_size>>
+        {
+            return bus.read_range(0, channel, first, count);
+        }
+
+        /**
+         * @brief Write consecutive words starting at first, clipped to the module size
+         *
+         * @note is thread safe, takes the module lock once and logs a single range write event
+         */
+        auto write_range(size_t channel, size_t first, const std::vector<std::bitset<word_size>> &values) -> void
+        {
+            bus.write_range(0, channel, first, values);
+        }
+
+        /**
+         * @brief Fill count words starting at first with value, clipped to the module size
+         *
+         * @note is thread safe, takes the module lock once and logs a single range write event
+         */
+        auto fill_range(size_t channel, size_t first, size_t count, std::bitset<word_size> value) -> void
+        {
+            bus.fill_range(0, channel, first, count, value);
+        }
+
+        /**
+         * @brief Back a module with a mapped ROM image instead of copying it word by word
+         *
+         * @note the image stays shared and read-only, guest writes copy the touched 4 KiB page first
+         */
+        auto map_rom_image(std::shared_ptr<const RomImage> image, size_t channel = 0) -> bool
+        {
+            if (!image || channel >= memory_modules)
+                return false;
+
+            memory[channel].map_image(std::move(image));
+            if (bus.devices[channel])
+                bus.devices[channel]->on_reload(channel);
+            bus.wake_parked_cores(channel, 0, memory[channel].size());
+
+            return true;
+        }
+
+        /**
+         * @brief Write a module to disk in the layout RomImage::open maps
+         */
+        auto save_rom_image(size_t channel, const std::filesystem::path &path) const -> bool
+        {
+            if (channel >= memory_modules)
+                return false;
+
+            std::vector<uint64_t> limbs;
+            {
+                const auto &module = memory[channel];
+                std::lock_guard<std::mutex> lock(module.memory_mutex);
+                limbs.resize(module.size() * Memory::limbs_per_word);
+                module.copy_limbs(0, module.size(), limbs.data());
+            }
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(limbs.data()), static_cast<std::streamsize>(limbs.size() * sizeof(uint64_t)));
+            return static_cast<bool>(file);
+        }
+
+        /**
+         * @brief Set the instruction on the given memory channel and index
+         *
+         * @param channel
+         * @param index
+         * @param value
+         *
+         * @note is thread safe
+         */
+        auto set_instruction_in_memory(size_t channel, size_t index, InstructionType type, RegisterIndex dest, RegisterIndex src_1 = RegisterIndex::R0, RegisterIndex src_2 = RegisterIndex::R0)
+        {
+            unsigned char instruction[4] = {to_uchar(type), to_uchar(dest), to_uchar(src_1), to_uchar(src_2)};
+            bus.write(true, 0, channel, index, instruction);
+        }
+
+        auto set_instruction_in_cpu(char cpu_id, short index, InstructionType type, RegisterIndex dest, RegisterIndex src_1 = RegisterIndex::R0, RegisterIndex src_2 = RegisterIndex::R0)
+        {
+            if (to_size_t(cpu_id) <= cores)
+                cpus[to_size_t(cpu_id)].add_instruction(index, type, dest, src_1, src_2);
+        }
+
+        auto set_memory_instruction_in_memory(size_t channel, size_t index, InstructionType type, RegisterIndex reg, unsigned char module, unsigned short address) -> void
+        {
+            const auto packed_operand = static_cast<unsigned char>((to_uchar(reg) << 4) | (module & 0x0F));
+            std::bitset<word_size> encoded(u32(type) << 24 | u32(packed_operand) << 16 | u32(address));
+            encoded <<= (word_size - 32);
+            bus.write(true, 0, channel, index, encoded);
+        }
+
+        auto set_memory_instruction_in_cpu(char cpu_id, short index, InstructionType type, RegisterIndex reg, unsigned char module, unsigned short address) -> void
+        {
+            if (to_size_t(cpu_id) <= cores)
+                cpus[to_size_t(cpu_id)].add_memory_instruction(index, type, reg, module, address);
+        }
+
+        auto set_word_in_cpu(char cpu_id, short index, std::bitset<word_size> value)
+        {
+            if (to_size_t(cpu_id) <= cores)
+                cpus[to_size_t(cpu_id)].add_word(index, value);
         }
 
         struct CpuRenderState
@@ -381,6 +1010,7 @@ namespace FIAT128
             size_t channel = 0;
             size_t index = 0;
             std::bitset<word_size> value;
+            size_t count = 1;
         };
 
         auto get_cpu_render_state() -> std::array<CpuRenderState, cores + 1>
@@ -394,7 +1024,7 @@ namespace FIAT128
                 states[i].stack_pointer = cpus[i].stack_pointer.to_ulong();
                 states[i].current_instruction = cpus[i].next_instruction_name();
                 states[i].current_instruction_detail = cpus[i].next_instruction_detail();
-                states[i].flags = cpus[i].flag;
+                states[i].flags = cpus[i].current_flags();
 
                 for (size_t reg_index = 0; reg_index < states[i].registers.size(); ++reg_index)
                     states[i].registers[reg_index] = cpus[i].reg[reg_index];
@@ -403,392 +1033,2064 @@ namespace FIAT128
             return states;
         }
 
-        auto get_memory_write_events_since(size_t last_sequence) const -> std::vector<MemoryWriteRenderEvent>
+        /**
+         * @brief Record every write in the event ring read by get_memory_write_events_since, on by default
+         *
+         * @note callers that only use subscribe_memory_writes can turn it off to save the ring append on every write
+         */
+        auto record_memory_writes(bool enabled = true) -> void
         {
-            auto raw_events = bus.get_memory_write_events_since(last_sequence);
-            std::vector<MemoryWriteRenderEvent> events;
-            events.reserve(raw_events.size());
+            bus.record_memory_writes(enabled);
+        }
 
-            for (const auto &event : raw_events)
-            {
-                events.push_back({event.sequence, event.cpu_id, event.channel, event.index, event.value});
-            }
+        /**
+         * @brief Every write after last_sequence that is still in the event ring
+         *
+         * @note sees the newest writes of every channel while record_memory_writes is on, subscribe_memory_writes
+         *       only delivers what the consumer asks for
+         */
+        auto get_memory_write_events_since(size_t last_sequence) const -> std::vector<MemoryWriteRenderEvent>
+        {
+            return to_render_events(bus.get_memory_write_events_since(last_sequence));
+        }
 
-            return events;
+        /**
+         * @brief Register a bounded queue of the writes matching filter
+         *
+         * @note Sequence numbers count the entries of this subscription, a gap means entries were dropped.
+         */
+        auto subscribe_memory_writes(const MemoryWriteFilter &filter = {}, size_t capacity = 512, WriteDropPolicy policy = WriteDropPolicy::DropOldest) -> MemoryWriteSubscription
+        {
+            return bus.subscribe_memory_writes(filter, capacity, policy);
         }
 
-        auto get_memory_snapshot() const -> std::array<std::vector<std::bitset<word_size>>, memory_modules>
+        auto unsubscribe_memory_writes(MemoryWriteSubscription token) -> void
         {
-            std::array<std::vector<std::bitset<word_size>>, memory_modules> snapshot;
+            bus.unsubscribe_memory_writes(token);
+        }
 
-            for (size_t channel = 0; channel < memory_modules; ++channel)
-            {
-                snapshot[channel].reserve(memory[channel].memory.size());
-                for (const auto &word : memory[channel].memory)
-                    snapshot[channel].push_back(word);
-            }
+        /**
+         * @brief Drain the writes queued for a subscription since the last poll
+         *
+         * @note returns std::nullopt for tokens this emulator did not hand out, e.g. after the emulator was replaced
+         */
+        auto poll_memory_writes(MemoryWriteSubscription token) -> std::optional<std::vector<MemoryWriteRenderEvent>>
+        {
+            auto raw_events = bus.poll_memory_writes(token);
+            if (!raw_events)
+                return std::nullopt;
 
-            return snapshot;
+            return to_render_events(*raw_events);
         }
 
-        auto get_gpu_framebuffer() const -> const std::vector<uint32_t> &
+        /**
+         * @brief Writes a subscription lost to its drop policy
+         */
+        auto dropped_memory_writes(MemoryWriteSubscription token) const -> size_t
         {
-            return gpu_framebuffer;
+            return bus.dropped_memory_writes(token);
         }
 
-        auto latest_memory_write_sequence() const -> size_t
+        /**
+         * @brief Trace accesses to an address range, returns 0 when the channel does not exist
+         *
+         * @note accesses to channels without an armed watchpoint only pay for one mask test
+         */
+        auto add_watchpoint(const Watchpoint &watch) -> WatchpointId
         {
-            return bus.latest_memory_write_sequence();
+            return bus.add_watchpoint(watch);
         }
 
-        auto set_cpu_entry_point(size_t cpu_id, size_t entry_point) -> void
+        auto remove_watchpoint(WatchpointId id) -> bool
         {
-            if (cpu_id > cores)
-                return;
-
-            cpus[cpu_id].stack_pointer = std::bitset<u32(std::log2(cache_size))>(entry_point);
-            cpus[cpu_id].flag.reset();
-            cpus[cpu_id].initialized = true;
-            cpus[cpu_id].new_instruction = true;
-            cpus[cpu_id].instruction_cycle = 0;
-            cpus[cpu_id].interrupt_enabled = false;
+            return bus.remove_watchpoint(id);
         }
 
-        auto set_cpu_halt_state(size_t cpu_id, bool halted) -> void
+        /**
+         * @brief Appends the watchpoint hits recorded after cursor to hits and returns the new cursor
+         *
+         * @note the hit buffer keeps the newest watch_hit_capacity hits, older ones count as dropped
+         */
+        auto collect_watch_hits(uint64_t cursor, std::vector<WatchHit> &hits) const -> uint64_t
         {
-            if (cpu_id > cores)
-                return;
-
-            if (halted)
-                cpus[cpu_id].flag.set(CPU::FlagIndex::HALT);
-            else
-                cpus[cpu_id].flag.reset(CPU::FlagIndex::HALT);
+            return bus.watch_hits.collect_since(cursor, hits);
         }
 
-        // auto set = [](auto &array, auto &&value, auto &&...indices)
-        // {
-        //     if constexpr (sizeof...(indices) == 0)
-        //     {
-        //         array = std::forward<decltype(value)>(value);
-        //     }
-        //     else
-        //     {
-        //         set(array[std::forward<decltype(indices)>(indices)...],
-        //             std::forward<decltype(value)>(value));
-        //     }
-        // };
+        /**
+         * @brief Hits overwritten before collect_watch_hits reached them, counted for a single reader
+         */
+        auto dropped_watch_hits() const -> uint64_t
+        {
+            return bus.watch_hits.dropped();
+        }
 
-    private:
-        /* This is the Memory struct, which represents a memory module in the emulator. It has a vector of bitsets to represent the memory, and a mutex to protect it from concurrent access. */
-        struct Memory
+        /**
+         * @brief Memory-mapped device attached to a BUS channel
+         *
+         * @note the channel keeps its Memory as backing store. Hooks run after the access reached the module and
+         *       outside its lock. on_read may replace the value handed to the reader. Range writes call on_write per
+         *       word, fills call it once with the fill value and the word count. Channels without a device are plain
+         *       RAM and skip the hooks.
+         */
+        struct Device
         {
-            Memory() : memory(0, std::bitset<word_size>(0)) {}
+            virtual ~Device() = default;
 
-            Memory(size_t size) : memory(size, std::bitset<word_size>(0)) {}
+            virtual auto on_read(size_t cpu_id, size_t index, std::bitset<word_size> &value) -> void
+            {
+                (void)cpu_id;
+                (void)index;
+                (void)value;
+            }
 
-            ~Memory() {}
+            virtual auto on_write(size_t cpu_id, size_t index, const std::bitset<word_size> &value, size_t count) -> void
+            {
+                (void)cpu_id;
+                (void)index;
+                (void)value;
+                (void)count;
+            }
 
-            // copy constructor
-            Memory(const Memory &other)
+            /**
+             * @brief The whole channel was replaced at once, e.g. by map_rom_image, without any word being written
+             */
+            virtual auto on_reload(size_t channel) -> void
             {
-                for (size_t i = 0; i < other.memory.size(); i++)
-                {
-                    memory[i] = other.memory[i];
-                }
+                (void)channel;
             }
 
-            // move constructor
-            Memory(Memory &&other) : memory(std::move(other.memory)) {}
+            /**
+             * @brief Devices that leave on_read alone return false, so bulk paths may read the channel directly
+             */
+            virtual auto observes_reads() const -> bool
+            {
+                return true;
+            }
+        };
 
-            // copy assignment
-            Memory &operator=(const Memory &other)
+        /**
+         * @brief Turns stores to a console channel into a character stream
+         *
+         * @note every store is pushed as position << 8 | low byte into a lock-free ring, so readers only pay for
+         *       output they have not seen. read_since applies them by position like the memory viewer, write_to
+         *       prints them in store order for headless runs.
+         */
+        struct ConsoleDevice final : Device
+        {
+            explicit ConsoleDevice(size_t size, size_t capacity = 4096) : cells(size), stream(capacity) {}
+
+            auto on_write(size_t cpu_id, size_t index, const std::bitset<word_size> &value, size_t count) -> void override
             {
-                for (size_t i = 0; i < other.memory.size(); i++)
+                (void)cpu_id;
+
+                uint64_t ch = 0;
+                for (size_t bit = 0; bit < std::min<size_t>(8, word_size); ++bit)
                 {
-                    memory[i] = other.memory[i];
+                    if (value[bit])
+                        ch |= uint64_t(1) << bit;
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (index + i < cells.size())
+                        cells[index + i].store(static_cast<uint8_t>(ch), std::memory_order_relaxed);
+                    stream.push(((index + i) << 8) | ch);
                 }
-                return *this;
             }
 
-            // move assignment
-            Memory &operator=(Memory &&other)
+            auto observes_reads() const -> bool override
             {
-                memory = std::move(other.memory);
-                return *this;
+                return false;
             }
 
-            auto read(size_t index) -> std::bitset<word_size>
+            /**
+             * @brief Applies the stores made after cursor to screen, one character per word of the channel, and
+             *        returns the new cursor
+             *
+             * @note 0 shows as ' ', carriage returns and line feeds as newlines and other non-printable bytes as '.',
+             *       matching the memory viewer's char preview. When the ring lapped the reader the whole screen is
+             *       rebuilt from the channel instead
+             */
+            auto read_since(uint64_t cursor, std::string &screen) const -> uint64_t
             {
-                std::lock_guard<std::mutex> lock(memory_mutex);
-                return memory[index];
+                std::vector<uint64_t> entries;
+                uint64_t skipped = 0;
+                const uint64_t next = stream.collect_since(cursor, entries, skipped);
+
+                if (screen.size() < cells.size())
+                    screen.resize(cells.size(), ' ');
+
+                if (skipped != 0)
+                {
+                    for (size_t i = 0; i < cells.size(); ++i)
+                        screen[i] = printable(cells[i].load(std::memory_order_relaxed));
+                    return next;
+                }
+
+                for (const uint64_t entry : entries)
+                {
+                    const size_t index = static_cast<size_t>(entry >> 8);
+                    if (index < screen.size())
+                        screen[index] = printable(static_cast<uint8_t>(entry & 0xFFU));
+                }
+
+                return next;
             }
 
-            void write(size_t index, std::bitset<word_size> value)
+            /**
+             * @brief Headless sink, writes the characters stored after cursor to out in store order and returns the
+             *        new cursor
+             *
+             * @note a teletype view: zero stores are left out and an overwrite prints as a new character
+             */
+            auto write_to(std::ostream &out, uint64_t cursor) const -> uint64_t
             {
-                std::lock_guard<std::mutex> lock(memory_mutex);
-                memory[index] = value;
+                std::vector<uint64_t> entries;
+                cursor = stream.collect_since(cursor, entries);
+
+                std::string text;
+                for (const uint64_t entry : entries)
+                {
+                    const auto ch = static_cast<uint8_t>(entry & 0xFFU);
+                    if (ch != 0)
+                        text.push_back(printable(ch));
+                }
+
+                out << text;
+                return cursor;
             }
 
-            void write(size_t index, unsigned char (&value)[4])
+            /**
+             * @brief Characters that were overwritten in the ring before any reader saw them
+             */
+            auto dropped() const -> uint64_t
             {
-                std::lock_guard<std::mutex> lock(memory_mutex);
-                memory[index] = (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= 96;
+                return stream.dropped();
             }
 
-            auto set_word(short index, std::bitset<word_size> word) -> bool
+        private:
+            static auto printable(uint8_t ch) -> char
             {
-                assert(index < cache_size);
-
-                memory[index] = word;
-
-                return true;
+                if (ch == 10 || ch == 13)
+                    return '\n';
+                if (ch == 0)
+                    return ' ';
+                if (ch >= 32 && ch <= 126)
+                    return static_cast<char>(ch);
+                return '.';
             }
 
-            std::vector<std::bitset<word_size>> memory;
-            std::mutex memory_mutex;
+            // the last character stored to each word, the screen is rebuilt from it when the ring lapped a reader
+            std::vector<std::atomic<uint8_t>> cells;
+            AtomicRing<uint64_t> stream;
         };
 
-        struct CPU;
+        /**
+         * @brief Attach a console device to channel, stores to it become a character stream
+         */
+        auto attach_console(size_t channel = 2, size_t capacity = 4096) -> std::shared_ptr<ConsoleDevice>
+        {
+            auto console = std::make_shared<ConsoleDevice>(channel < memory_modules ? memory[channel].size() : 0, capacity);
+            bus.attach_device(channel, console);
+            return console;
+        }
 
-    private:
-        enum class GpuOpcode : uint8_t
+        /**
+         * @brief Turn channel into the register file of a DMA controller that run() services in bulk
+         *
+         * @note registers are the low 32 bits of words 0-9: 0 control (bits 0-7 = 0xD1 starts a transfer, bits 8-15 =
+         *       CPU id + 1 to interrupt on completion, 0 for none), 1/2 source module/address, 3/4 destination
+         *       module/address, 5 length in words, 6/7 source/destination stride (0 means 1), 8 status (0 idle, 1 busy,
+         *       2 done, 3 fault) and 9 words transferred. Each run() moves at most dma_chunk_words words, so transfers
+         *       overlap CPU execution. A start command while busy replaces the active transfer.
+         */
+        auto attach_dma(size_t channel) -> void
         {
-            Load = 0,
-            Store = 1,
-            PixelStore = 2,
-            Add = 3,
-            Sub = 4,
-            Mul = 5,
-            Div = 6,
-            Mod = 7,
-            Neg = 8,
-            Abs = 9,
-            Dot = 10,
-            Cross = 11,
-            Length = 12,
-            Normalize = 13,
-            Lerp = 14,
-            Clamp = 15,
-            Eq = 16,
-            Ne = 17,
-            Lt = 18,
-            Le = 19,
-            Gt = 20,
-            Ge = 21,
-            And = 22,
-            Or = 23,
-            Xor = 24,
-            Not = 25,
-            Shl = 26,
-            Shr = 27,
-            Jmp = 28,
-            Jz = 29,
-            Jnz = 30,
-            Halt = 31,
-            ReadInvocationIdX = 32,
-            ReadInvocationIdY = 33,
-            ReadWidth = 34,
-            ReadHeight = 35,
-            PackRgb = 36,
-            PackRgba = 37,
-            UnpackRgb = 38,
-            UnpackRgba = 39,
-        };
+            if (channel >= memory_modules)
+                return;
 
-        struct GpuInstruction
+            dma_device = std::make_shared<DmaDevice>();
+            dma_device->interrupt_targets = &bus.dma_interrupt_targets;
+            dma_channel = channel;
+            dma_transfer = {};
+            bus.dma_interrupt_targets.store(0, std::memory_order_release);
+            bus.attach_device(channel, dma_device);
+        }
+
+        /**
+         * @brief The channel attach_dma() put the DMA controller on, nullopt while none is attached
+         */
+        auto get_dma_channel() const -> std::optional<size_t>
         {
-            GpuOpcode opcode = GpuOpcode::Halt;
-            uint8_t dst = 0;
-            uint8_t src1 = 0;
-            uint8_t src2 = 0;
-            uint32_t immediate = 0;
-        };
+            if (!dma_device)
+                return std::nullopt;
 
-        static constexpr size_t gpu_width = 400;
-        static constexpr size_t gpu_height = 600;
-        static constexpr size_t gpu_register_count = 16;
-        static constexpr size_t gpu_entry_point = 3;
-        static constexpr size_t gpu_step_limit = 2048;
+            return dma_channel;
+        }
 
-        static auto decode_gpu_instruction(const std::bitset<word_size> &word) -> GpuInstruction
+        /**
+         * @brief Attach a device to a memory channel, nullptr turns the channel back into plain RAM
+         */
+        auto attach_device(size_t channel, std::shared_ptr<Device> device) -> void
         {
-            const uint64_t raw = word.to_ullong();
+            bus.attach_device(channel, std::move(device));
+        }
 
-            return {
-                static_cast<GpuOpcode>(raw & 0xFFULL),
-                static_cast<uint8_t>((raw >> 8) & 0xFFULL),
-                static_cast<uint8_t>((raw >> 16) & 0xFFULL),
-                static_cast<uint8_t>((raw >> 24) & 0xFFULL),
-                static_cast<uint32_t>((raw >> 32) & 0xFFFFFFFFULL),
-            };
+        /**
+         * @brief Cap the number of 4 KiB pages a module may allocate, 0 removes the cap
+         *
+         * @note non-zero writes that would need a page past the cap are dropped and counted, see get_memory_refused_writes
+         */
+        auto set_memory_page_limit(size_t channel, size_t page_limit) -> void
+        {
+            if (channel >= memory_modules)
+                return;
+
+            std::lock_guard<std::mutex> lock(memory[channel].memory_mutex);
+            memory[channel].page_limit = page_limit;
         }
 
-        auto ensure_gpu_framebuffer() -> void
+        auto get_memory_resident_pages(size_t channel) const -> size_t
         {
-            const size_t required_size = gpu_width * gpu_height;
-            if (gpu_framebuffer.size() != required_size)
-                gpu_framebuffer.assign(required_size, 0xFF000000U);
+            if (channel >= memory_modules)
+                return 0;
+
+            std::lock_guard<std::mutex> lock(memory[channel].memory_mutex);
+            return memory[channel].resident_pages;
         }
 
-        auto write_gpu_pixel(size_t x, size_t y, uint32_t color) -> void
+        /**
+         * @brief Number of words the module dropped because its page limit was reached
+         */
+        auto get_memory_refused_writes(size_t channel) const -> size_t
         {
-            if (x >= gpu_width || y >= gpu_height)
-                return;
+            if (channel >= memory_modules)
+                return 0;
 
-            ensure_gpu_framebuffer();
-            gpu_framebuffer[y * gpu_width + x] = 0xFF000000U | (color & 0x00FFFFFFU);
+            std::lock_guard<std::mutex> lock(memory[channel].memory_mutex);
+            return memory[channel].refused_writes;
         }
 
-        static auto clamp_register_index(uint8_t index) -> size_t
+        static constexpr auto get_memory_module_count() -> size_t
         {
-            return index % gpu_register_count;
+            return memory_modules;
         }
 
-        static auto low_32(std::uint64_t value) -> uint32_t
+        auto get_memory_snapshot() const -> std::array<std::vector<std::bitset<word_size>>, memory_modules>
         {
-            return static_cast<uint32_t>(value & 0xFFFFFFFFULL);
+            std::array<std::vector<std::bitset<word_size>>, memory_modules> snapshot;
+
+            for (size_t channel = 0; channel < memory_modules; ++channel)
+            {
+                const auto &module = memory[channel];
+                std::lock_guard<std::mutex> lock(module.memory_mutex);
+
+                snapshot[channel].reserve(module.size());
+                for (size_t index = 0; index < module.size(); ++index)
+                    snapshot[channel].push_back(module.load(index));
+            }
+
+            return snapshot;
         }
 
-        static auto pack_rgb_from_scalars(int64_t red, int64_t green, int64_t blue) -> uint32_t
+        struct MemoryPageDelta
         {
-            return (static_cast<uint32_t>(red) & 0xFFU) << 16U |
-                   (static_cast<uint32_t>(green) & 0xFFU) << 8U |
-                   (static_cast<uint32_t>(blue) & 0xFFU);
+            size_t channel = 0;
+            size_t first_index = 0;
+            std::vector<std::bitset<word_size>> words;
+        };
+
+        /**
+         * @brief Copies the pages of one module written after since_generation
+         *
+         * @return the module generation the delta is current to, pass it back as since_generation next time
+         *
+         * @note generations start at 1, so since_generation 0 returns every resident page. A written page that is no
+         *       longer resident reads as zero and comes back with empty words, since_generation 0 leaves those out.
+         */
+        auto snapshot_delta(size_t channel, uint64_t since_generation, std::vector<MemoryPageDelta> &pages) const -> uint64_t
+        {
+            if (channel >= memory_modules)
+                return 0;
+
+            const auto &module = memory[channel];
+            std::lock_guard<std::mutex> lock(module.memory_mutex);
+
+            if (module.generation <= since_generation)
+                return module.generation;
+
+            module.for_each_dirty_page(since_generation, [&](size_t page, bool resident)
+            {
+                if (!resident && since_generation == 0)
+                    return;
+
+                const size_t first = page * Memory::page_words;
+                const size_t count = resident ? std::min(Memory::page_words, module.size() - first) : 0;
+
+                auto &delta = pages.emplace_back();
+                delta.channel = channel;
+                delta.first_index = first;
+                delta.words.resize(count);
+                for (size_t i = 0; i < count; ++i)
+                    delta.words[i] = module.load(first + i);
+            });
+
+            return module.generation;
         }
 
-        auto execute_gpu_invocation(size_t invocation_x, size_t invocation_y) -> void
+        /**
+         * @brief Consumer-side copy of memory that update_mirror keeps current one dirty page at a time
+         *
+         * @note only pages holding a non-zero word are stored, the rest of a module reads as 0
+         */
+        struct MemoryMirror
         {
-            std::array<int64_t, gpu_register_count> registers{};
-            registers[12] = static_cast<int64_t>(invocation_x);
-            registers[13] = static_cast<int64_t>(invocation_y);
-            registers[14] = static_cast<int64_t>(gpu_width);
-            registers[15] = static_cast<int64_t>(gpu_height);
+            auto size(size_t channel) const -> size_t
+            {
+                return channel < memory_modules ? sizes[channel] : 0;
+            }
 
-            size_t pc = gpu_entry_point;
+            auto word(size_t channel, size_t index) const -> std::bitset<word_size>
+            {
+                if (channel >= memory_modules)
+                    return std::bitset<word_size>(0);
+
+                const auto found = pages[channel].find(index / Memory::page_words);
+                return found != pages[channel].end() ? found->second[index % Memory::page_words] : std::bitset<word_size>(0);
+            }
 
-            for (size_t step = 0; step < gpu_step_limit && pc < memory[3].memory.size(); ++step)
+            std::array<std::unordered_map<size_t, std::vector<std::bitset<word_size>>>, memory_modules> pages;
+            std::array<size_t, memory_modules> sizes{};
+            std::array<uint64_t, memory_modules> generations{};
+            uint64_t source = 0;
+        };
+
+        /**
+         * @brief Bring a mirror up to date, copying only pages written since its last update
+         *
+         * @return bit n is set when module n changed, a mirror last updated from another emulator is fully refreshed
+         */
+        auto update_mirror(MemoryMirror &mirror, uint64_t modules = ~0ULL) const -> uint64_t
+        {
+            if (mirror.source != instance_id)
             {
-                const auto instruction_word = bus.read(true, 0, 3, pc);
-                ++pc;
+                mirror = MemoryMirror{};
+                mirror.source = instance_id;
+            }
 
-                const auto instruction = decode_gpu_instruction(instruction_word);
-                const size_t dst = clamp_register_index(instruction.dst);
-                const size_t src1 = clamp_register_index(instruction.src1);
-                const size_t src2 = clamp_register_index(instruction.src2);
+            uint64_t changed = 0;
+            std::vector<MemoryPageDelta> pages;
 
-                auto &dst_reg = registers[dst];
-                const auto &src1_reg = registers[src1];
-                const auto &src2_reg = registers[src2];
+            for (size_t channel = 0; channel < memory_modules && channel < 64; ++channel)
+            {
+                if (((modules >> channel) & 1U) == 0)
+                    continue;
 
-                switch (instruction.opcode)
-                {
-                case GpuOpcode::Load:
-                {
-                    const auto loaded = bus.read(true, 0, 3, static_cast<size_t>(instruction.immediate));
-                    dst_reg = static_cast<int64_t>(low_32(loaded.to_ullong()));
-                    break;
-                }
-                case GpuOpcode::Store:
-                    set_word_in_memory(3, static_cast<size_t>(instruction.immediate), std::bitset<word_size>(static_cast<uint64_t>(dst_reg)));
-                    break;
-                case GpuOpcode::PixelStore:
-                    write_gpu_pixel(invocation_x, invocation_y, static_cast<uint32_t>(dst_reg));
-                    break;
-                case GpuOpcode::Add:
-                    dst_reg = src1_reg + src2_reg;
-                    break;
-                case GpuOpcode::Sub:
-                    dst_reg = src1_reg - src2_reg;
-                    break;
-                case GpuOpcode::Mul:
-                    dst_reg = src1_reg * src2_reg;
-                    break;
-                case GpuOpcode::Div:
-                    dst_reg = (src2_reg == 0) ? 0 : (src1_reg / src2_reg);
-                    break;
-                case GpuOpcode::Mod:
-                    dst_reg = (src2_reg == 0) ? 0 : (src1_reg % src2_reg);
-                    break;
-                case GpuOpcode::Neg:
-                    dst_reg = -src1_reg;
-                    break;
-                case GpuOpcode::Abs:
-                    dst_reg = std::llabs(src1_reg);
-                    break;
-                case GpuOpcode::Dot:
-                    dst_reg = registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 0))] +
-                              registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 1))] +
-                              registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 2))];
-                    break;
-                case GpuOpcode::Cross:
-                {
-                    const auto ax = registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))];
-                    const auto ay = registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))];
-                    const auto az = registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))];
-                    const auto bx = registers[clamp_register_index(static_cast<uint8_t>(src2 + 0))];
-                    const auto by = registers[clamp_register_index(static_cast<uint8_t>(src2 + 1))];
-                    const auto bz = registers[clamp_register_index(static_cast<uint8_t>(src2 + 2))];
+                pages.clear();
+                const uint64_t generation = snapshot_delta(channel, mirror.generations[channel], pages);
+                if (generation == mirror.generations[channel])
+                    continue;
 
-                    registers[clamp_register_index(instruction.dst + 0)] = ay * bz - az * by;
-                    registers[clamp_register_index(instruction.dst + 1)] = az * bx - ax * bz;
-                    registers[clamp_register_index(instruction.dst + 2)] = ax * by - ay * bx;
-                    break;
-                }
-                case GpuOpcode::Length:
+                mirror.sizes[channel] = memory[channel].size();
+                for (auto &page : pages)
                 {
-                    const long double x = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))]);
-                    const long double y = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))]);
-                    const long double z = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))]);
-                    dst_reg = static_cast<int64_t>(std::sqrt((x * x) + (y * y) + (z * z)));
-                    break;
+                    const size_t page_index = page.first_index / Memory::page_words;
+                    if (std::all_of(page.words.begin(), page.words.end(), [](const auto &word)
+                                    { return word.none(); }))
+                        mirror.pages[channel].erase(page_index);
+                    else
+                        mirror.pages[channel][page_index] = std::move(page.words);
                 }
-                case GpuOpcode::Normalize:
-                {
-                    const long double x = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))]);
-                    const long double y = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))]);
-                    const long double z = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))]);
-                    const long double length = std::sqrt((x * x) + (y * y) + (z * z));
-                    const long double scale = (length == 0.0L) ? 0.0L : (1.0L / length);
 
-                    registers[clamp_register_index(instruction.dst + 0)] = static_cast<int64_t>(std::llround(x * scale * 1000000.0L));
-                    registers[clamp_register_index(instruction.dst + 1)] = static_cast<int64_t>(std::llround(y * scale * 1000000.0L));
-                    registers[clamp_register_index(instruction.dst + 2)] = static_cast<int64_t>(std::llround(z * scale * 1000000.0L));
-                    break;
-                }
-                case GpuOpcode::Lerp:
-                {
-                    const int64_t factor = static_cast<int64_t>(instruction.immediate & 0xFFFFU);
-                    dst_reg = src1_reg + (((src2_reg - src1_reg) * factor) / 65535);
-                    break;
-                }
-                case GpuOpcode::Clamp:
-                {
-                    const int64_t minimum = src2_reg;
-                    const int64_t maximum = static_cast<int64_t>(instruction.immediate);
-                    dst_reg = std::clamp(src1_reg, minimum, maximum);
-                    break;
-                }
-                case GpuOpcode::Eq:
-                    dst_reg = (src1_reg == src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::Ne:
-                    dst_reg = (src1_reg != src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::Lt:
-                    dst_reg = (src1_reg < src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::Le:
-                    dst_reg = (src1_reg <= src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::Gt:
-                    dst_reg = (src1_reg > src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::Ge:
-                    dst_reg = (src1_reg >= src2_reg) ? 1 : 0;
-                    break;
-                case GpuOpcode::And:
-                    dst_reg = src1_reg & src2_reg;
-                    break;
+                mirror.generations[channel] = generation;
+                changed |= 1ULL << channel;
+            }
+
+            return changed;
+        }
+
+        /**
+         * @brief Returns the framebuffer as ARGB8888
+         *
+         * @note compact formats are expanded once per dispatch into a cached copy, renderers that want the pixels
+         *       without any copy should use get_gpu_framebuffer_view()
+         */
+        auto get_gpu_framebuffer() const -> const std::vector<uint32_t> &
+        {
+            if (gpu_pixel_format == GpuPixelFormat::Argb8888)
+                return gpu_framebuffer;
+
+            std::lock_guard<std::mutex> lock(gpu_framebuffer_resolved_mutex);
+            if (gpu_framebuffer_resolved_frame != gpu_frame)
+            {
+                resolve_gpu_framebuffer(gpu_framebuffer_resolved);
+                gpu_framebuffer_resolved_frame = gpu_frame;
+            }
+            return gpu_framebuffer_resolved;
+        }
+
+        /**
+         * @brief Expands the framebuffer into out as ARGB8888, whatever the active pixel format
+         *
+         * @note out is reused, so a caller resolving every frame allocates only when the size changes
+         */
+        auto resolve_gpu_framebuffer(std::vector<uint32_t> &out) const -> void
+        {
+            switch (gpu_pixel_format)
+            {
+            case GpuPixelFormat::Rgb565:
+                out.resize(gpu_framebuffer_rgb565.size());
+                std::transform(gpu_framebuffer_rgb565.begin(), gpu_framebuffer_rgb565.end(), out.begin(), decode_rgb565);
+                break;
+            case GpuPixelFormat::Indexed8:
+                out.resize(gpu_framebuffer_indexed.size());
+                std::transform(gpu_framebuffer_indexed.begin(), gpu_framebuffer_indexed.end(), out.begin(), [this](uint8_t index)
+                               { return gpu_palette[index]; });
+                break;
+            case GpuPixelFormat::Argb8888:
+            default:
+                out.assign(gpu_framebuffer.begin(), gpu_framebuffer.end());
+                break;
+            }
+        }
+
+        struct GpuFramebufferView
+        {
+            GpuPixelFormat format = GpuPixelFormat::Argb8888;
+            const void *pixels = nullptr;
+            size_t width = 0;
+            size_t height = 0;
+            size_t pitch = 0;
+            const std::array<uint32_t, 256> *palette = nullptr;
+        };
+
+        /**
+         * @brief Returns the framebuffer in its native pixel format, pixels is null before the first dispatch
+         *
+         * @note pitch is in bytes, palette is only set for Indexed8 and holds ARGB8888 colors
+         */
+        auto get_gpu_framebuffer_view() const -> GpuFramebufferView
+        {
+            GpuFramebufferView view;
+            view.format = gpu_pixel_format;
+            view.width = gpu_width;
+            view.height = gpu_height;
+
+            switch (gpu_pixel_format)
+            {
+            case GpuPixelFormat::Rgb565:
+                view.pixels = gpu_framebuffer_rgb565.empty() ? nullptr : gpu_framebuffer_rgb565.data();
+                view.pitch = gpu_width * sizeof(uint16_t);
+                break;
+            case GpuPixelFormat::Indexed8:
+                view.pixels = gpu_framebuffer_indexed.empty() ? nullptr : gpu_framebuffer_indexed.data();
+                view.pitch = gpu_width * sizeof(uint8_t);
+                view.palette = &gpu_palette;
+                break;
+            case GpuPixelFormat::Argb8888:
+            default:
+                view.pixels = gpu_framebuffer.empty() ? nullptr : gpu_framebuffer.data();
+                view.pitch = gpu_width * sizeof(uint32_t);
+                break;
+            }
+
+            return view;
+        }
+
+        struct GpuShaderCacheStats
+        {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t entries = 0;
+        };
+
+        auto get_gpu_shader_cache_stats() const -> GpuShaderCacheStats
+        {
+            auto stats = gpu_shader_cache_stats;
+            stats.entries = gpu_shader_cache.size();
+            return stats;
+        }
+
+        /**
+         * @brief True when a GPU command was written to RAM3 word 0 and has not been serviced yet
+         */
+        auto has_pending_gpu_command() const -> bool
+        {
+            return gpu_device && gpu_device->doorbell.load(std::memory_order_acquire);
+        }
+
+        auto latest_memory_write_sequence() const -> size_t
+        {
+            return bus.latest_memory_write_sequence();
+        }
+
+        /**
+         * @brief Number of write events that fell out of the event ring before they could be read
+         *
+         * @note assumes one reader of get_memory_write_events_since, a second reader's progress hides the first one's losses
+         */
+        auto dropped_memory_write_events() const -> size_t
+        {
+            return bus.dropped_memory_write_events();
+        }
+
+        auto set_cpu_entry_point(size_t cpu_id, size_t entry_point) -> void
+        {
+            if (cpu_id > cores)
+                return;
+
+            cpus[cpu_id].stack_pointer = std::bitset<u32(std::log2(cache_size))>(entry_point);
+            cpus[cpu_id].flag.reset();
+            cpus[cpu_id].pending_flags = 0;
+            cpus[cpu_id].set_halted(false);
+            cpus[cpu_id].spin_branch = CPU::no_spin_branch;
+            cpus[cpu_id].initialized = true;
+            cpus[cpu_id].new_instruction = true;
+            cpus[cpu_id].instruction_cycle = 0;
+            cpus[cpu_id].interrupt_enabled = false;
+        }
+
+        auto set_cpu_halt_state(size_t cpu_id, bool halted) -> void
+        {
+            if (cpu_id > cores)
+                return;
+
+            cpus[cpu_id].set_halted(halted);
+        }
+
+        // auto set = [](auto &array, auto &&value, auto &&...indices)
+        // {
+        //     if constexpr (sizeof...(indices) == 0)
+        //     {
+        //         array = std::forward<decltype(value)>(value);
+        //     }
+        //     else
+        //     {
+        //         set(array[std::forward<decltype(indices)>(indices)...],
+        //             std::forward<decltype(value)>(value));
+        //     }
+        // };
+
+    private:
+        template <typename LogEntries>
+        static auto to_render_events(const LogEntries &raw_events) -> std::vector<MemoryWriteRenderEvent>
+        {
+            std::vector<MemoryWriteRenderEvent> events;
+            events.reserve(raw_events.size());
+
+            for (const auto &event : raw_events)
+            {
+                events.push_back({event.sequence, event.cpu_id, event.channel, event.index, event.value, event.count});
+            }
+
+            return events;
+        }
+
+        /* This is the Memory struct, which represents a memory module in the emulator. Words are stored as uint64_t limbs (lowest limb first) in 4 KiB, 64-byte aligned pages that are only allocated on the first non-zero write, so untouched pages read as zero and cost nothing. Pages are looked up through a two-level directory whose tables are also allocated on first use, so a module's footprint follows the pages it touches rather than its declared size. A page can instead be backed by a read-only ROM image mapping and is copied into a private page on its first write. Words are exposed through a bitset view, with a mutex to protect them from concurrent access. */
+        struct Memory
+        {
+            static constexpr size_t limbs_per_word = (word_size + 63) / 64;
+
+            // 4 KiB pages, the granularity of allocation and of dirty tracking
+            static constexpr size_t page_words = std::max<size_t>(1, 4096 / (limbs_per_word * sizeof(uint64_t)));
+            static constexpr size_t page_limbs = page_words * limbs_per_word;
+
+            // pages are grouped into tables of table_pages, a table is only allocated once a page in its range is
+            // written or mapped
+            static constexpr size_t table_pages = 512;
+
+            struct alignas(64) Page
+            {
+                std::array<uint64_t, page_limbs> limbs{};
+            };
+
+            struct PageTable
+            {
+                std::array<std::unique_ptr<Page>, table_pages> pages;
+                std::array<const uint64_t *, table_pages> backing{}; // ROM image page shown while pages[i] is empty
+                std::array<uint64_t, table_pages> generations{};      // generation of the last write to each page
+            };
+
+            Memory() = default;
+
+            Memory(size_t size)
+                : words(size), page_count((size + page_words - 1) / page_words), tables((page_count + table_pages - 1) / table_pages),
+                  table_generations(tables.size(), 0) {}
+
+            ~Memory() {}
+
+            // copy constructor
+            Memory(const Memory &other)
+                : words(other.words), page_count(other.page_count), page_limit(other.page_limit), image(other.image), generation(other.generation),
+                  table_generations(other.table_generations)
+            {
+                copy_pages_from(other);
+            }
+
+            // move constructor
+            Memory(Memory &&other)
+                : words(std::exchange(other.words, 0)), page_count(std::exchange(other.page_count, 0)), page_limit(other.page_limit),
+                  resident_pages(std::exchange(other.resident_pages, 0)), refused_writes(other.refused_writes), tables(std::move(other.tables)),
+                  image(std::move(other.image)), generation(other.generation), table_generations(std::move(other.table_generations)) {}
+
+            // copy assignment
+            Memory &operator=(const Memory &other)
+            {
+                words = other.words;
+                page_count = other.page_count;
+                page_limit = other.page_limit;
+                image = other.image;
+                generation = other.generation;
+                table_generations = other.table_generations;
+                copy_pages_from(other);
+                return *this;
+            }
+
+            // move assignment
+            Memory &operator=(Memory &&other)
+            {
+                words = std::exchange(other.words, 0);
+                page_count = std::exchange(other.page_count, 0);
+                page_limit = other.page_limit;
+                resident_pages = std::exchange(other.resident_pages, 0);
+                refused_writes = other.refused_writes;
+                tables = std::move(other.tables);
+                image = std::move(other.image);
+                generation = other.generation;
+                table_generations = std::move(other.table_generations);
+                return *this;
+            }
+
+            auto size() const -> size_t
+            {
+                return words;
+            }
+
+            /**
+             * @brief Unlocked pointer to the limbs of one word, resolving to the private page, the ROM image or a shared zero page
+             */
+            auto word_limbs(size_t index) const -> const uint64_t *
+            {
+                return page_limbs_of(index / page_words) + (index % page_words) * limbs_per_word;
+            }
+
+            /**
+             * @brief Unlocked bitset view of one word, the caller holds memory_mutex or owns the module
+             */
+            auto load(size_t index) const -> std::bitset<word_size>
+            {
+                const uint64_t *word = word_limbs(index);
+                std::bitset<word_size> value(word[limbs_per_word - 1]);
+
+                for (size_t limb = limbs_per_word - 1; limb-- > 0;)
+                {
+                    value <<= 64;
+                    value |= std::bitset<word_size>(word[limb]);
+                }
+
+                return value;
+            }
+
+            /**
+             * @brief Unlocked store of one word from its bitset view
+             *
+             * @note zero stores into untouched pages allocate nothing, stores past the page limit are dropped
+             */
+            auto store(size_t index, const std::bitset<word_size> &value) -> void
+            {
+                if (uint64_t *word = writable_limbs(index, value.none()))
+                    encode_word(value, word);
+            }
+
+            /**
+             * @brief Unlocked decode of count words starting at first into out, pages that were never written are
+             *        filled with zero words without decoding
+             */
+            auto load_range(size_t first, size_t count, std::bitset<word_size> *out) const -> void
+            {
+                while (count > 0)
+                {
+                    const size_t chunk = std::min(count, page_words - first % page_words);
+                    const size_t page = first / page_words;
+
+                    if (is_resident(page))
+                    {
+                        for (size_t i = 0; i < chunk; ++i)
+                            out[i] = load(first + i);
+                    }
+                    else
+                    {
+                        std::fill(out, out + chunk, std::bitset<word_size>(0));
+                    }
+
+                    out += chunk;
+                    first += chunk;
+                    count -= chunk;
+                }
+            }
+
+            /**
+             * @brief Unlocked read of a 32-bit lane, lane 0 is the lowest 32 bits of the word
+             *
+             * @note lanes past word_size read as 0, like gpu_word_lane
+             */
+            auto lane(size_t index, size_t lane) const -> uint32_t
+            {
+                if (lane * 32 >= word_size)
+                    return 0;
+
+                return static_cast<uint32_t>(word_limbs(index)[lane / 2] >> ((lane % 2) * 32));
+            }
+
+            /**
+             * @brief True when the page holds words of its own or shows a ROM image page, other pages read as 0
+             */
+            auto is_resident(size_t page) const -> bool
+            {
+                const auto *table = tables[page / table_pages].get();
+                return table && (table->pages[page % table_pages] || table->backing[page % table_pages]);
+            }
+
+            /**
+             * @brief Calls visit(page, resident) for every page written after since, the caller holds memory_mutex
+             *
+             * @note tables that were never allocated are passed over whole unless a write covered all of them
+             */
+            template <typename Visit>
+            auto for_each_dirty_page(uint64_t since, Visit &&visit) const -> void
+            {
+                for (size_t table_index = 0; table_index < tables.size(); ++table_index)
+                {
+                    const auto *table = tables[table_index].get();
+                    const uint64_t table_generation = table_generations[table_index];
+                    if (!table && table_generation <= since)
+                        continue;
+
+                    const size_t first = table_index * table_pages;
+                    const size_t end = std::min(first + table_pages, page_count);
+                    for (size_t page = first; page < end; ++page)
+                    {
+                        const uint64_t page_generation = table ? std::max(table_generation, table->generations[page - first]) : table_generation;
+                        if (page_generation > since)
+                            visit(page, is_resident(page));
+                    }
+                }
+            }
+
+            /**
+             * @brief Unlocked copy of the limbs of count words into out, one memcpy or memset per page
+             */
+            auto copy_limbs(size_t first, size_t count, uint64_t *out) const -> void
+            {
+                while (count > 0)
+                {
+                    const size_t chunk = std::min(count, page_words - first % page_words);
+                    const size_t page = first / page_words;
+
+                    if (is_resident(page))
+                        std::memcpy(out, word_limbs(first), chunk * limbs_per_word * sizeof(uint64_t));
+                    else
+                        std::memset(out, 0, chunk * limbs_per_word * sizeof(uint64_t));
+
+                    out += chunk * limbs_per_word;
+                    first += chunk;
+                    count -= chunk;
+                }
+            }
+
+            /**
+             * @brief Stamps the pages covering [first, first + count) with a new generation, the caller holds memory_mutex
+             *
+             * @note a range that covers a whole table stamps the table instead of its pages, a partly covered table
+             *       that was never allocated is skipped as no page in it could have changed
+             */
+            auto mark_dirty(size_t first, size_t count) -> void
+            {
+                if (count == 0)
+                    return;
+
+                ++generation;
+                const size_t last_page = (first + count - 1) / page_words;
+                for (size_t page = first / page_words; page <= last_page;)
+                {
+                    const size_t table_first = page - page % table_pages;
+                    const size_t table_end = std::min(table_first + table_pages, page_count);
+                    if (page == table_first && last_page + 1 >= table_end)
+                    {
+                        table_generations[page / table_pages] = generation;
+                        page = table_end;
+                        continue;
+                    }
+
+                    auto *table = tables[page / table_pages].get();
+                    if (!table)
+                    {
+                        page = std::min(table_end, last_page + 1);
+                        continue;
+                    }
+
+                    table->generations[page % table_pages] = generation;
+                    ++page;
+                }
+            }
+
+            auto read(size_t index) -> std::bitset<word_size>
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                return load(index);
+            }
+
+            void write(size_t index, std::bitset<word_size> value)
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                store(index, value);
+                mark_dirty(index, 1);
+            }
+
+            void write(size_t index, unsigned char (&value)[4])
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                store(index, (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= (word_size - 32));
+                mark_dirty(index, 1);
+            }
+
+            /**
+             * @brief Copies count words starting at first into values under a single lock
+             */
+            auto read_range(size_t first, size_t count, std::vector<std::bitset<word_size>> &values) -> void
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                values.resize(count);
+                for (size_t i = 0; i < count; ++i)
+                    values[i] = load(first + i);
+            }
+
+            /**
+             * @brief Stores count words starting at first under a single lock
+             */
+            auto write_range(size_t first, const std::bitset<word_size> *values, size_t count) -> void
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                for (size_t i = 0; i < count; ++i)
+                    store(first + i, values[i]);
+                mark_dirty(first, count);
+            }
+
+            /**
+             * @brief Fills count words starting at first with one value
+             *
+             * @note zero fills release every page they cover completely and memset the rest, other values are
+             *       stored once per page and then doubled with memcpy
+             */
+            auto fill_range(size_t first, size_t count, const std::bitset<word_size> &value) -> void
+            {
+                if (count == 0)
+                    return;
+
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                mark_dirty(first, count);
+
+                while (count > 0)
+                {
+                    const size_t chunk = std::min(count, page_words - first % page_words);
+                    const size_t page_index = first / page_words;
+
+                    if (value.none())
+                    {
+                        if (chunk == page_words)
+                        {
+                            release_page(page_index);
+                        }
+                        else if (is_resident(page_index))
+                        {
+                            if (uint64_t *begin = writable_limbs(first, false, chunk))
+                                std::memset(begin, 0, chunk * limbs_per_word * sizeof(uint64_t));
+                        }
+                    }
+                    else if (uint64_t *begin = writable_limbs(first, false, chunk))
+                    {
+                        encode_word(value, begin);
+                        for (size_t filled = 1; filled < chunk;)
+                        {
+                            const size_t copy = std::min(filled, chunk - filled);
+                            std::memcpy(begin + filled * limbs_per_word, begin, copy * limbs_per_word * sizeof(uint64_t));
+                            filled += copy;
+                        }
+                    }
+
+                    first += chunk;
+                    count -= chunk;
+                }
+            }
+
+            /**
+             * @brief Zeroes the whole module by releasing every page and dropping the ROM image
+             */
+            auto clear() -> void
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                release_tables();
+                image.reset();
+                mark_dirty(0, words);
+            }
+
+            /**
+             * @brief Backs the module with a ROM image, replacing its contents without copying
+             *
+             * @note whole pages point into the mapping, a partial last page is copied, words past the image read zero
+             */
+            auto map_image(std::shared_ptr<const RomImage> rom) -> void
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                release_tables();
+
+                image = std::move(rom);
+                const size_t image_words = image ? std::min(words, image->size() / (limbs_per_word * sizeof(uint64_t))) : 0;
+
+                for (size_t page = 0; page * page_words < image_words; ++page)
+                {
+                    const auto *source = reinterpret_cast<const uint64_t *>(image->data()) + page * page_limbs;
+                    const size_t page_word_count = std::min(page_words, image_words - page * page_words);
+
+                    auto &table = table_for(page);
+                    if (page_word_count == page_words)
+                    {
+                        table.backing[page % table_pages] = source;
+                    }
+                    else
+                    {
+                        auto &private_page = table.pages[page % table_pages];
+                        private_page = std::make_unique<Page>();
+                        std::memcpy(private_page->limbs.data(), source, page_word_count * limbs_per_word * sizeof(uint64_t));
+                        ++resident_pages;
+                    }
+                }
+
+                mark_dirty(0, words);
+            }
+
+            auto set_word(short index, std::bitset<word_size> word) -> bool
+            {
+                assert(index < cache_size);
+
+                store(index, word);
+                mark_dirty(static_cast<size_t>(index), 1);
+
+                return true;
+            }
+
+            size_t words = 0;
+            size_t page_count = 0;
+            size_t page_limit = 0; // 0 means no limit on resident pages
+            size_t resident_pages = 0;
+            size_t refused_writes = 0; // words dropped because page_limit was reached
+            std::vector<std::unique_ptr<PageTable>> tables;
+            std::shared_ptr<const RomImage> image;
+            uint64_t generation = 1;
+            std::vector<uint64_t> table_generations; // generation of the last write that covered a whole table
+            mutable std::mutex memory_mutex;
+
+        private:
+            static auto encode_word(const std::bitset<word_size> &value, uint64_t *word) -> void
+            {
+                if constexpr (limbs_per_word == 1)
+                {
+                    word[0] = value.to_ullong();
+                }
+                else
+                {
+                    static const std::bitset<word_size> limb_mask(~0ULL);
+                    for (size_t limb = 0; limb < limbs_per_word; ++limb)
+                        word[limb] = ((value >> (limb * 64)) & limb_mask).to_ullong();
+                }
+            }
+
+            auto page_limbs_of(size_t page) const -> const uint64_t *
+            {
+                static const Page zero_page{};
+
+                const auto *table = tables[page / table_pages].get();
+                if (!table)
+                    return zero_page.limbs.data();
+
+                const size_t slot = page % table_pages;
+                if (table->pages[slot])
+                    return table->pages[slot]->limbs.data();
+
+                return table->backing[slot] ? table->backing[slot] : zero_page.limbs.data();
+            }
+
+            auto table_for(size_t page) -> PageTable &
+            {
+                auto &table = tables[page / table_pages];
+                if (!table) [[unlikely]]
+                    table = std::make_unique<PageTable>();
+
+                return *table;
+            }
+
+            /**
+             * @brief Limbs of the word at index in a private page, allocated or copied from the ROM image on demand
+             *
+             * @note nullptr for a zero store into an untouched page, which needs nothing, and for a page past the page
+             *       limit, which counts words as refused
+             */
+            auto writable_limbs(size_t index, bool zero_value, size_t words_written = 1) -> uint64_t *
+            {
+                const size_t page_index = index / page_words;
+                auto *table = tables[page_index / table_pages].get();
+                const size_t slot = page_index % table_pages;
+
+                if (!table || !table->pages[slot]) [[unlikely]]
+                {
+                    const uint64_t *source = table ? table->backing[slot] : nullptr;
+                    if (zero_value && !source)
+                        return nullptr;
+
+                    if (page_limit != 0 && resident_pages >= page_limit)
+                    {
+                        refused_writes += words_written;
+                        return nullptr;
+                    }
+
+                    // copy-on-write for pages still shown from the ROM image
+                    table = &table_for(page_index);
+                    table->pages[slot] = std::make_unique<Page>();
+                    if (source)
+                        std::memcpy(table->pages[slot]->limbs.data(), source, page_limbs * sizeof(uint64_t));
+                    table->backing[slot] = nullptr;
+                    ++resident_pages;
+                }
+
+                return table->pages[slot]->limbs.data() + (index % page_words) * limbs_per_word;
+            }
+
+            auto release_page(size_t page) -> void
+            {
+                auto *table = tables[page / table_pages].get();
+                if (!table)
+                    return;
+
+                const size_t slot = page % table_pages;
+                table->backing[slot] = nullptr;
+                if (!table->pages[slot])
+                    return;
+
+                table->pages[slot].reset();
+                --resident_pages;
+            }
+
+            // drops every page and page stamp, callers stamp the whole module afterwards
+            auto release_tables() -> void
+            {
+                for (auto &table : tables)
+                    table.reset();
+                resident_pages = 0;
+            }
+
+            auto copy_pages_from(const Memory &other) -> void
+            {
+                tables.clear();
+                tables.resize(other.tables.size());
+                resident_pages = 0;
+                refused_writes = other.refused_writes;
+
+                for (size_t table_index = 0; table_index < tables.size(); ++table_index)
+                {
+                    const auto *source = other.tables[table_index].get();
+                    if (!source)
+                        continue;
+
+                    auto &table = tables[table_index];
+                    table = std::make_unique<PageTable>();
+                    table->backing = source->backing;
+                    table->generations = source->generations;
+
+                    for (size_t slot = 0; slot < table_pages; ++slot)
+                    {
+                        if (!source->pages[slot])
+                            continue;
+
+                        table->pages[slot] = std::make_unique<Page>(*source->pages[slot]);
+                        ++resident_pages;
+                    }
+                }
+            }
+        };
+
+        struct CPU;
+
+    private:
+        enum class GpuOpcode : uint8_t
+        {
+            Load = 0,
+            Store = 1,
+            PixelStore = 2,
+            Add = 3,
+            Sub = 4,
+            Mul = 5,
+            Div = 6,
+            Mod = 7,
+            Neg = 8,
+            Abs = 9,
+            Dot = 10,
+            Cross = 11,
+            Length = 12,
+            Normalize = 13,
+            Lerp = 14,
+            Clamp = 15,
+            Eq = 16,
+            Ne = 17,
+            Lt = 18,
+            Le = 19,
+            Gt = 20,
+            Ge = 21,
+            And = 22,
+            Or = 23,
+            Xor = 24,
+            Not = 25,
+            Shl = 26,
+            Shr = 27,
+            Jmp = 28,
+            Jz = 29,
+            Jnz = 30,
+            Halt = 31,
+            ReadInvocationIdX = 32,
+            ReadInvocationIdY = 33,
+            ReadWidth = 34,
+            ReadHeight = 35,
+            PackRgb = 36,
+            PackRgba = 37,
+            UnpackRgb = 38,
+            UnpackRgba = 39,
+            DepthTest = 40,
+            PixelStoreDepth = 41,
+        };
+
+        enum class GpuBlendMode : uint8_t
+        {
+            Replace = 0,
+            Alpha = 1,
+            Additive = 2,
+        };
+
+        struct GpuInstruction
+        {
+            GpuOpcode opcode = GpuOpcode::Halt;
+            uint8_t dst = 0;
+            uint8_t src1 = 0;
+            uint8_t src2 = 0;
+            uint32_t immediate = 0;
+        };
+
+        static constexpr size_t gpu_width = 400;
+        static constexpr size_t gpu_height = 600;
+        static constexpr size_t gpu_register_count = 16;
+        static constexpr size_t gpu_config_word = 2;
+        static constexpr size_t gpu_entry_point = 3;
+        static constexpr size_t gpu_step_limit = 2048;
+        static constexpr size_t gpu_blit_limit = 256;
+        static constexpr size_t gpu_pixels_per_word = 4;
+
+        static constexpr uint8_t gpu_command_shader = 0xFFU;
+        static constexpr uint8_t gpu_command_blit = 0xB1U;
+
+        /**
+         * @brief A decoded blit descriptor (one RAM3 word, four 32-bit lanes)
+         *
+         * @note lane 0 = source address, lane 1 = width | height << 16, lane 2 = x | y << 16 (signed),
+         *       lane 3 = color key (bits 0-23) | scale (bits 24-30) | color key enable (bit 31)
+         */
+        struct GpuBlitDescriptor
+        {
+            size_t source = 0;
+            size_t width = 0;
+            size_t height = 0;
+            int64_t x = 0;
+            int64_t y = 0;
+            size_t scale = 1;
+            bool color_keyed = false;
+            uint32_t color_key = 0;
+        };
+
+        using GpuProgram = std::vector<GpuInstruction>;
+
+        struct GpuShaderCacheEntry
+        {
+            uint64_t hash = 0;
+            std::vector<uint64_t> source;
+            std::shared_ptr<const GpuProgram> program;
+        };
+
+        static constexpr size_t gpu_shader_cache_capacity = 8;
+
+        /**
+         * @brief RAM3 device, invalidates the active shader on shader writes and rings the doorbell on command bytes
+         */
+        struct GpuDevice final : Device
+        {
+            auto on_write(size_t cpu_id, size_t index, const std::bitset<word_size> &value, size_t count) -> void override
+            {
+                (void)cpu_id;
+
+                if (index + count > gpu_entry_point && index < shader_end.load(std::memory_order_acquire))
+                    shader_write_generation.fetch_add(1, std::memory_order_release);
+
+                if (index == 0)
+                {
+                    const auto command = static_cast<uint8_t>(gpu_word_lane(value, 0) & 0xFFU);
+                    if (command == gpu_command_shader || command == gpu_command_blit)
+                        doorbell.store(true, std::memory_order_release);
+                }
+            }
+
+            auto on_reload(size_t channel) -> void override
+            {
+                (void)channel;
+                shader_write_generation.fetch_add(1, std::memory_order_release);
+            }
+
+            auto observes_reads() const -> bool override
+            {
+                return false;
+            }
+
+            // bumped on every write into the shader range of RAM3, invalidates the active GPU shader
+            std::atomic<size_t> shader_write_generation{0};
+
+            // one past the last word of the decoded shader, writes from here on are data and keep it
+            std::atomic<size_t> shader_end{std::numeric_limits<size_t>::max()};
+
+            // rung when a GPU command byte is written to RAM3 word 0, consumed by execute_gpu_shader
+            std::atomic<bool> doorbell{false};
+        };
+
+        std::shared_ptr<GpuDevice> gpu_device;
+
+        static constexpr uint8_t dma_command_start = 0xD1U;
+        static constexpr size_t dma_chunk_words = 256;
+
+        /**
+         * @brief Bit of the core a DMA transfer interrupts, every bit when the core is past the 64 a mask can tell apart
+         */
+        static constexpr auto dma_interrupt_mask(size_t interrupt_cpu) -> uint64_t
+        {
+            if (interrupt_cpu == 0)
+                return 0;
+
+            return interrupt_cpu <= 64 ? uint64_t(1) << (interrupt_cpu - 1) : ~uint64_t(0);
+        }
+
+        // BUS id of DMA traffic in write events, one past the last CPU
+        static constexpr size_t dma_bus_id = cores + 1;
+
+        enum DmaRegister : size_t
+        {
+            DmaControl = 0,
+            DmaSourceModule = 1,
+            DmaSourceAddress = 2,
+            DmaDestinationModule = 3,
+            DmaDestinationAddress = 4,
+            DmaLength = 5,
+            DmaSourceStride = 6,
+            DmaDestinationStride = 7,
+            DmaStatus = 8,
+            DmaTransferred = 9,
+        };
+
+        enum class DmaState : uint32_t
+        {
+            Idle = 0,
+            Busy = 1,
+            Done = 2,
+            Fault = 3,
+        };
+
+        /**
+         * @brief Register file of the DMA controller, latches start commands for service_dma
+         */
+        struct DmaDevice final : Device
+        {
+            auto on_write(size_t cpu_id, size_t index, const std::bitset<word_size> &value, size_t count) -> void override
+            {
+                (void)cpu_id;
+                (void)count;
+
+                const uint32_t control = gpu_word_lane(value, 0);
+                if (index == DmaControl && (control & 0xFFU) == dma_command_start)
+                {
+                    if (interrupt_targets)
+                        interrupt_targets->fetch_or(dma_interrupt_mask((control >> 8) & 0xFFU), std::memory_order_release);
+                    doorbell.store(true, std::memory_order_release);
+                }
+            }
+
+            auto observes_reads() const -> bool override
+            {
+                return false;
+            }
+
+            std::atomic<bool> doorbell{false};
+
+            // the BUS mask of cores a requested transfer will interrupt
+            std::atomic<uint64_t> *interrupt_targets = nullptr;
+        };
+
+        struct DmaTransfer
+        {
+            size_t source_module = 0;
+            size_t source = 0;
+            size_t source_stride = 1;
+            size_t destination_module = 0;
+            size_t destination = 0;
+            size_t destination_stride = 1;
+            size_t remaining = 0;
+            size_t transferred = 0;
+            size_t interrupt_cpu = 0;
+            bool active = false;
+        };
+
+        std::shared_ptr<DmaDevice> dma_device;
+        size_t dma_channel = 0;
+        DmaTransfer dma_transfer;
+
+        /**
+         * @brief Decodes the low 64 bits of a shader word, which is the first limb of the word in memory
+         */
+        static auto decode_gpu_instruction(uint64_t raw) -> GpuInstruction
+        {
+            return {
+                static_cast<GpuOpcode>(raw & 0xFFULL),
+                static_cast<uint8_t>((raw >> 8) & 0xFFULL),
+                static_cast<uint8_t>((raw >> 16) & 0xFFULL),
+                static_cast<uint8_t>((raw >> 24) & 0xFFULL),
+                static_cast<uint32_t>((raw >> 32) & 0xFFFFFFFFULL),
+            };
+        }
+
+        static auto encode_rgb565(uint32_t color) -> uint16_t
+        {
+            return static_cast<uint16_t>(((color >> 8U) & 0xF800U) | ((color >> 5U) & 0x07E0U) | ((color >> 3U) & 0x001FU));
+        }
+
+        static auto decode_rgb565(uint16_t pixel) -> uint32_t
+        {
+            const uint32_t red = (pixel >> 11U) & 0x1FU;
+            const uint32_t green = (pixel >> 5U) & 0x3FU;
+            const uint32_t blue = pixel & 0x1FU;
+
+            return 0xFF000000U |
+                   (((red << 3U) | (red >> 2U)) << 16U) |
+                   (((green << 2U) | (green >> 4U)) << 8U) |
+                   ((blue << 3U) | (blue >> 2U));
+        }
+
+        // GPU RAM is the only channel with built-in behaviour, everything else starts as plain RAM
+        auto attach_builtin_devices() -> void
+        {
+            if constexpr (memory_modules > 3)
+            {
+                gpu_device = std::make_shared<GpuDevice>();
+                bus.attach_device(3, gpu_device);
+                ensure_gpu_framebuffer();
+            }
+        }
+
+        /**
+         * @brief Frees the buffers of the inactive pixel formats and sizes the active one
+         */
+        auto ensure_gpu_framebuffer() -> void
+        {
+            const size_t required_size = gpu_width * gpu_height;
+
+            auto ensure = [&](auto &buffer, auto clear_value, bool active)
+            {
+                if (!active)
+                {
+                    if (!buffer.empty())
+                        std::decay_t<decltype(buffer)>().swap(buffer);
+                }
+                else if (buffer.size() != required_size)
+                {
+                    buffer.assign(required_size, clear_value);
+                }
+            };
+
+            ensure(gpu_framebuffer, 0xFF000000U, gpu_pixel_format == GpuPixelFormat::Argb8888);
+            ensure(gpu_framebuffer_rgb565, uint16_t(0), gpu_pixel_format == GpuPixelFormat::Rgb565);
+            ensure(gpu_framebuffer_indexed, uint8_t(0), gpu_pixel_format == GpuPixelFormat::Indexed8);
+            ensure(gpu_depth_buffer, gpu_depth_clear_value, gpu_depth_enabled);
+        }
+
+        /**
+         * @brief Latches the pixel format and palette from the GPU config word at the start of a dispatch
+         *
+         * @note bits 32-39 select the format, bits 64-95 hold the palette address (256 entries, four per word),
+         *       bits 96-103 select the blend mode, bit 104 enables the depth buffer and bit 105 clears it
+         */
+        auto latch_gpu_config() -> void
+        {
+            const auto config = bus.read(true, 0, 3, gpu_config_word);
+            const auto requested = static_cast<uint8_t>(gpu_word_lane(config, 1) & 0xFFU);
+            gpu_pixel_format = requested <= static_cast<uint8_t>(GpuPixelFormat::Indexed8) ? static_cast<GpuPixelFormat>(requested) : GpuPixelFormat::Argb8888;
+
+            const uint32_t raster = gpu_word_lane(config, 3);
+            const auto blend = static_cast<uint8_t>(raster & 0xFFU);
+            gpu_blend_mode = blend <= static_cast<uint8_t>(GpuBlendMode::Additive) ? static_cast<GpuBlendMode>(blend) : GpuBlendMode::Replace;
+            gpu_depth_enabled = (raster & 0x100U) != 0;
+
+            ensure_gpu_framebuffer();
+
+            if (gpu_depth_enabled && (raster & 0x200U) != 0)
+                std::fill(gpu_depth_buffer.begin(), gpu_depth_buffer.end(), gpu_depth_clear_value);
+
+            if (gpu_pixel_format != GpuPixelFormat::Indexed8)
+                return;
+
+            const size_t palette_base = gpu_word_lane(config, 2);
+            auto &gpu_ram = memory[3];
+            std::lock_guard<std::mutex> lock(gpu_ram.memory_mutex);
+
+            for (size_t entry = 0; entry < gpu_palette.size(); ++entry)
+            {
+                const size_t index = palette_base + entry / gpu_pixels_per_word;
+                const uint32_t color = index < gpu_ram.size() ? gpu_ram.lane(index, entry % gpu_pixels_per_word) : 0;
+                gpu_palette[entry] = 0xFF000000U | (color & 0x00FFFFFFU);
+            }
+        }
+
+        /**
+         * @brief Combines a source color with the pixel already in the framebuffer
+         *
+         * @note alpha blending takes the source alpha from bits 24-31, additive blending saturates each channel
+         */
+        static auto blend_gpu_color(GpuBlendMode mode, uint32_t destination, uint32_t source) -> uint32_t
+        {
+            switch (mode)
+            {
+            case GpuBlendMode::Alpha:
+            {
+                const uint32_t alpha = source >> 24U;
+                const uint32_t inverse = 255U - alpha;
+                auto channel = [&](uint32_t shift)
+                {
+                    return ((((source >> shift) & 0xFFU) * alpha + ((destination >> shift) & 0xFFU) * inverse + 127U) / 255U) << shift;
+                };
+                return 0xFF000000U | channel(16U) | channel(8U) | channel(0U);
+            }
+            case GpuBlendMode::Additive:
+            {
+                auto channel = [&](uint32_t shift)
+                {
+                    return std::min<uint32_t>(255U, ((source >> shift) & 0xFFU) + ((destination >> shift) & 0xFFU)) << shift;
+                };
+                return 0xFF000000U | channel(16U) | channel(8U) | channel(0U);
+            }
+            case GpuBlendMode::Replace:
+            default:
+                return 0xFF000000U | (source & 0x00FFFFFFU);
+            }
+        }
+
+        /**
+         * @brief Stores a color at a framebuffer offset through the active format and blend mode
+         *
+         * @note indexed framebuffers always replace, palette indices cannot be blended
+         */
+        auto store_gpu_color(size_t offset, uint32_t color) -> void
+        {
+            switch (gpu_pixel_format)
+            {
+            case GpuPixelFormat::Rgb565:
+            {
+                auto &pixel = gpu_framebuffer_rgb565[offset];
+                pixel = gpu_blend_mode == GpuBlendMode::Replace ? encode_rgb565(color) : encode_rgb565(blend_gpu_color(gpu_blend_mode, decode_rgb565(pixel), color));
+                break;
+            }
+            case GpuPixelFormat::Indexed8:
+                gpu_framebuffer_indexed[offset] = static_cast<uint8_t>(color & 0xFFU);
+                break;
+            case GpuPixelFormat::Argb8888:
+            default:
+                gpu_framebuffer[offset] = blend_gpu_color(gpu_blend_mode, gpu_framebuffer[offset], color);
+                break;
+            }
+        }
+
+        auto write_gpu_pixel(size_t x, size_t y, uint32_t color) -> void
+        {
+            if (x >= gpu_width || y >= gpu_height)
+                return;
+
+            store_gpu_color(y * gpu_width + x, color);
+        }
+
+        /**
+         * @brief Early depth rejection, a fragment passes when its depth is below the stored depth
+         */
+        auto gpu_depth_passes(size_t x, size_t y, uint32_t depth) const -> bool
+        {
+            if (!gpu_depth_enabled || x >= gpu_width || y >= gpu_height)
+                return true;
+
+            return depth < gpu_depth_buffer[y * gpu_width + x];
+        }
+
+        auto write_gpu_pixel_depth(size_t x, size_t y, uint32_t color, uint32_t depth) -> void
+        {
+            if (!gpu_depth_passes(x, y, depth))
+                return;
+
+            write_gpu_pixel(x, y, color);
+
+            if (gpu_depth_enabled && x < gpu_width && y < gpu_height)
+                gpu_depth_buffer[y * gpu_width + x] = depth;
+        }
+
+        /**
+         * @brief Extracts one 32-bit lane from a GPU RAM word
+         *
+         * @note lane 0 is the lowest 32 bits, lanes past the word size read as zero
+         */
+        static auto gpu_word_lane(const std::bitset<word_size> &word, size_t lane) -> uint32_t
+        {
+            if (lane * 32 >= word_size)
+                return 0;
+
+            return static_cast<uint32_t>(((word >> (lane * 32)) & std::bitset<word_size>(0xFFFFFFFFULL)).to_ullong());
+        }
+
+        static auto decode_gpu_blit(const std::bitset<word_size> &word) -> GpuBlitDescriptor
+        {
+            const uint32_t size = gpu_word_lane(word, 1);
+            const uint32_t position = gpu_word_lane(word, 2);
+            const uint32_t mode = gpu_word_lane(word, 3);
+
+            GpuBlitDescriptor descriptor;
+            descriptor.source = gpu_word_lane(word, 0);
+            descriptor.width = size & 0xFFFFU;
+            descriptor.height = size >> 16U;
+            descriptor.x = static_cast<int16_t>(position & 0xFFFFU);
+            descriptor.y = static_cast<int16_t>(position >> 16U);
+            descriptor.scale = std::max<size_t>(1, (mode >> 24U) & 0x7FU);
+            descriptor.color_keyed = (mode >> 31U) != 0;
+            descriptor.color_key = mode & 0x00FFFFFFU;
+            return descriptor;
+        }
+
+        /**
+         * @brief Writes one unpacked source row into a framebuffer row, clipped to the screen
+         *
+         * @param row the source pixels already encoded in the framebuffer format
+         * @param key the color key encoded in the framebuffer format
+         */
+        template <typename Pixel>
+        auto blit_gpu_row(const std::vector<Pixel> &row, const GpuBlitDescriptor &descriptor, int64_t y, std::vector<Pixel> &framebuffer, Pixel key) -> void
+        {
+            if (y < 0 || y >= static_cast<int64_t>(gpu_height))
+                return;
+
+            const int64_t scaled_width = static_cast<int64_t>(row.size() * descriptor.scale);
+            const int64_t first = std::max<int64_t>(0, -descriptor.x);
+            const int64_t last = std::min<int64_t>(scaled_width, static_cast<int64_t>(gpu_width) - descriptor.x);
+            if (first >= last)
+                return;
+
+            Pixel *target = framebuffer.data() + static_cast<size_t>(y) * gpu_width + static_cast<size_t>(descriptor.x + first);
+            const size_t count = static_cast<size_t>(last - first);
+
+            if (descriptor.scale == 1 && !descriptor.color_keyed) [[likely]]
+            {
+                std::memcpy(target, row.data() + first, count * sizeof(Pixel));
+                return;
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const Pixel pixel = row[(static_cast<size_t>(first) + i) / descriptor.scale];
+                const bool transparent = descriptor.color_keyed && pixel == key;
+                target[i] = transparent ? target[i] : pixel;
+            }
+        }
+
+        /**
+         * @brief Encodes one unpacked ARGB row into the active framebuffer format and blits every scaled copy of it
+         */
+        auto blit_gpu_source_row(const std::vector<uint32_t> &row, const GpuBlitDescriptor &descriptor, int64_t first_y) -> void
+        {
+            if (gpu_blend_mode != GpuBlendMode::Replace && gpu_pixel_format != GpuPixelFormat::Indexed8)
+            {
+                blit_gpu_source_row_blended(row, descriptor, first_y);
+                return;
+            }
+
+            auto blit_scaled = [&](const auto &encoded_row, auto &framebuffer, auto key)
+            {
+                for (size_t repeat = 0; repeat < descriptor.scale; ++repeat)
+                    blit_gpu_row(encoded_row, descriptor, first_y + static_cast<int64_t>(repeat), framebuffer, key);
+            };
+
+            switch (gpu_pixel_format)
+            {
+            case GpuPixelFormat::Rgb565:
+            {
+                gpu_blit_row_rgb565.resize(row.size());
+                std::transform(row.begin(), row.end(), gpu_blit_row_rgb565.begin(), encode_rgb565);
+                blit_scaled(gpu_blit_row_rgb565, gpu_framebuffer_rgb565, encode_rgb565(descriptor.color_key));
+                break;
+            }
+            case GpuPixelFormat::Indexed8:
+            {
+                gpu_blit_row_indexed.resize(row.size());
+                std::transform(row.begin(), row.end(), gpu_blit_row_indexed.begin(), [](uint32_t color)
+                               { return static_cast<uint8_t>(color & 0xFFU); });
+                blit_scaled(gpu_blit_row_indexed, gpu_framebuffer_indexed, static_cast<uint8_t>(descriptor.color_key & 0xFFU));
+                break;
+            }
+            case GpuPixelFormat::Argb8888:
+            default:
+                blit_scaled(row, gpu_framebuffer, 0xFF000000U | descriptor.color_key);
+                break;
+            }
+        }
+
+        /**
+         * @brief Blends one unpacked ARGB row into the framebuffer pixel by pixel, keeping the source alpha
+         */
+        auto blit_gpu_source_row_blended(const std::vector<uint32_t> &row, const GpuBlitDescriptor &descriptor, int64_t first_y) -> void
+        {
+            const int64_t scaled_width = static_cast<int64_t>(row.size() * descriptor.scale);
+            const int64_t first = std::max<int64_t>(0, -descriptor.x);
+            const int64_t last = std::min<int64_t>(scaled_width, static_cast<int64_t>(gpu_width) - descriptor.x);
+
+            for (size_t repeat = 0; repeat < descriptor.scale; ++repeat)
+            {
+                const int64_t y = first_y + static_cast<int64_t>(repeat);
+                if (y < 0 || y >= static_cast<int64_t>(gpu_height))
+                    continue;
+
+                const size_t row_offset = static_cast<size_t>(y) * gpu_width;
+                for (int64_t x = first; x < last; ++x)
+                {
+                    const uint32_t pixel = row[static_cast<size_t>(x) / descriptor.scale];
+                    if (descriptor.color_keyed && (pixel & 0x00FFFFFFU) == descriptor.color_key)
+                        continue;
+
+                    store_gpu_color(row_offset + static_cast<size_t>(descriptor.x + x), pixel);
+                }
+            }
+        }
+
+        /**
+         * @brief Runs the blit list referenced by the GPU config word
+         *
+         * @note each source row starts on a word boundary and packs four pixels per word, lowest lane first
+         */
+        auto execute_gpu_blits() -> void
+        {
+            auto &gpu_ram = memory[3];
+            std::lock_guard<std::mutex> lock(gpu_ram.memory_mutex);
+
+            if (gpu_ram.size() <= gpu_config_word)
+                return;
+
+            std::vector<uint32_t> row;
+            size_t descriptor_index = gpu_ram.lane(gpu_config_word, 0);
+
+            for (size_t blit = 0; blit < gpu_blit_limit && descriptor_index < gpu_ram.size(); ++blit, ++descriptor_index)
+            {
+                const auto descriptor = decode_gpu_blit(gpu_ram.load(descriptor_index));
+                if (descriptor.width == 0 || descriptor.height == 0)
+                    break;
+
+                const size_t words_per_row = (descriptor.width + gpu_pixels_per_word - 1) / gpu_pixels_per_word;
+                row.resize(descriptor.width);
+
+                for (size_t source_y = 0; source_y < descriptor.height; ++source_y)
+                {
+                    const size_t row_base = descriptor.source + source_y * words_per_row;
+                    if (row_base + words_per_row > gpu_ram.size())
+                        break;
+
+                    for (size_t x = 0; x < descriptor.width; ++x)
+                    {
+                        const uint32_t pixel = gpu_ram.lane(row_base + x / gpu_pixels_per_word, x % gpu_pixels_per_word);
+                        row[x] = gpu_blend_mode == GpuBlendMode::Alpha ? pixel : 0xFF000000U | (pixel & 0x00FFFFFFU);
+                    }
+
+                    blit_gpu_source_row(row, descriptor, descriptor.y + static_cast<int64_t>(source_y * descriptor.scale));
+                }
+            }
+        }
+
+        static auto clamp_register_index(uint8_t index) -> size_t
+        {
+            return index % gpu_register_count;
+        }
+
+        static auto low_32(std::uint64_t value) -> uint32_t
+        {
+            return static_cast<uint32_t>(value & 0xFFFFFFFFULL);
+        }
+
+        static auto pack_rgb_from_scalars(int64_t red, int64_t green, int64_t blue) -> uint32_t
+        {
+            return (static_cast<uint32_t>(red) & 0xFFU) << 16U |
+                   (static_cast<uint32_t>(green) & 0xFFU) << 8U |
+                   (static_cast<uint32_t>(blue) & 0xFFU);
+        }
+
+        /**
+         * @brief FNV-1a hash over every 64-bit limb of the shader words
+         */
+        static auto hash_gpu_shader(const std::vector<uint64_t> &source) -> uint64_t
+        {
+            uint64_t hash = 0xCBF29CE484222325ULL;
+
+            for (const uint64_t limb : source)
+            {
+                hash ^= limb;
+                hash *= 0x100000001B3ULL;
+            }
+
+            return hash;
+        }
+
+        /**
+         * @brief Returns the decoded shader for the current RAM3 contents
+         *
+         * @note the shader runs from gpu_entry_point to the first HALT at or past every jump target before it, only
+         *       those words are hashed and only writes to them make the next dispatch read them again. Decoding
+         *       is skipped when their content hash is in the LRU cache
+         */
+        auto acquire_gpu_shader() -> std::shared_ptr<const GpuProgram>
+        {
+            const size_t generation = gpu_device->shader_write_generation.load(std::memory_order_acquire);
+            if (gpu_active_shader && generation == gpu_active_shader_generation) [[likely]]
+            {
+                ++gpu_shader_cache_stats.hits;
+                return gpu_active_shader;
+            }
+
+            constexpr size_t limbs_per_word = Memory::limbs_per_word;
+            std::vector<uint64_t> source;
+            {
+                auto &gpu_ram = memory[3];
+                std::lock_guard<std::mutex> lock(gpu_ram.memory_mutex);
+
+                size_t reach = gpu_entry_point;
+                for (size_t index = gpu_entry_point; index < gpu_ram.size(); ++index)
+                {
+                    source.resize(source.size() + limbs_per_word);
+                    gpu_ram.copy_limbs(index, 1, source.data() + source.size() - limbs_per_word);
+
+                    const auto instruction = decode_gpu_instruction(source[source.size() - limbs_per_word]);
+                    if (instruction.opcode == GpuOpcode::Jmp || instruction.opcode == GpuOpcode::Jz || instruction.opcode == GpuOpcode::Jnz)
+                        reach = std::max<size_t>(reach, instruction.immediate);
+                    else if (instruction.opcode == GpuOpcode::Halt && index >= reach)
+                        break;
+                }
+
+                // published under the RAM3 lock, so a write the scan missed tests itself against the new extent
+                gpu_device->shader_end.store(gpu_entry_point + source.size() / limbs_per_word, std::memory_order_release);
+            }
+
+            const uint64_t hash = hash_gpu_shader(source);
+            gpu_active_shader_generation = generation;
+
+            for (auto it = gpu_shader_cache.begin(); it != gpu_shader_cache.end(); ++it)
+            {
+                if (it->hash != hash || it->source != source)
+                    continue;
+
+                gpu_shader_cache.splice(gpu_shader_cache.begin(), gpu_shader_cache, it);
+                ++gpu_shader_cache_stats.hits;
+                gpu_active_shader = gpu_shader_cache.front().program;
+                return gpu_active_shader;
+            }
+
+            auto program = std::make_shared<GpuProgram>();
+            program->reserve(source.size() / limbs_per_word);
+            for (size_t limb = 0; limb < source.size(); limb += limbs_per_word)
+                program->push_back(decode_gpu_instruction(source[limb]));
+
+            gpu_shader_cache.push_front({hash, std::move(source), program});
+            if (gpu_shader_cache.size() > gpu_shader_cache_capacity)
+                gpu_shader_cache.pop_back();
+
+            ++gpu_shader_cache_stats.misses;
+            gpu_active_shader = std::move(program);
+            return gpu_active_shader;
+        }
+
+        /**
+         * @brief Decodes the RAM3 word at index as it is now, for an invocation that rewrote its own shader
+         */
+        auto fetch_gpu_instruction(size_t index) -> GpuInstruction
+        {
+            auto &gpu_ram = memory[3];
+            uint64_t limbs[Memory::limbs_per_word];
+            std::lock_guard<std::mutex> lock(gpu_ram.memory_mutex);
+            gpu_ram.copy_limbs(index, 1, limbs);
+            return decode_gpu_instruction(limbs[0]);
+        }
+
+        /**
+         * @brief Runs the shader for one pixel
+         *
+         * @note fetches come from the decoded snapshot until the invocation stores into its own code, from then on it
+         *       fetches from RAM3. Other invocations of the dispatch keep the snapshot, the next dispatch decodes the
+         *       new code
+         */
+        auto execute_gpu_invocation(const GpuProgram &program, size_t invocation_x, size_t invocation_y) -> void
+        {
+            std::array<int64_t, gpu_register_count> registers{};
+            registers[12] = static_cast<int64_t>(invocation_x);
+            registers[13] = static_cast<int64_t>(invocation_y);
+            registers[14] = static_cast<int64_t>(gpu_width);
+            registers[15] = static_cast<int64_t>(gpu_height);
+
+            size_t pc = gpu_entry_point;
+            size_t code_size = program.size();
+            bool self_modified = false;
+
+            for (size_t step = 0; step < gpu_step_limit && pc >= gpu_entry_point && pc - gpu_entry_point < code_size; ++step)
+            {
+                const GpuInstruction instruction = self_modified ? fetch_gpu_instruction(pc) : program[pc - gpu_entry_point];
+                ++pc;
+
+                const size_t dst = clamp_register_index(instruction.dst);
+                const size_t src1 = clamp_register_index(instruction.src1);
+                const size_t src2 = clamp_register_index(instruction.src2);
+
+                auto &dst_reg = registers[dst];
+                const auto &src1_reg = registers[src1];
+                const auto &src2_reg = registers[src2];
+
+                switch (instruction.opcode)
+                {
+                case GpuOpcode::Load:
+                {
+                    const auto loaded = bus.read(true, 0, 3, static_cast<size_t>(instruction.immediate));
+                    dst_reg = static_cast<int64_t>(low_32(loaded.to_ullong()));
+                    break;
+                }
+                case GpuOpcode::Store:
+                {
+                    const size_t address = static_cast<size_t>(instruction.immediate);
+                    set_word_in_memory(3, address, std::bitset<word_size>(static_cast<uint64_t>(dst_reg)));
+                    if (!self_modified && address >= gpu_entry_point && address - gpu_entry_point < program.size())
+                    {
+                        self_modified = true;
+                        code_size = memory[3].size() - gpu_entry_point;
+                    }
+                    break;
+                }
+                case GpuOpcode::PixelStore:
+                    write_gpu_pixel(invocation_x, invocation_y, static_cast<uint32_t>(dst_reg));
+                    break;
+                case GpuOpcode::DepthTest:
+                    if (!gpu_depth_passes(invocation_x, invocation_y, static_cast<uint32_t>(src1_reg)))
+                        return;
+                    break;
+                case GpuOpcode::PixelStoreDepth:
+                    write_gpu_pixel_depth(invocation_x, invocation_y, static_cast<uint32_t>(dst_reg), static_cast<uint32_t>(src1_reg));
+                    break;
+                case GpuOpcode::Add:
+                    dst_reg = src1_reg + src2_reg;
+                    break;
+                case GpuOpcode::Sub:
+                    dst_reg = src1_reg - src2_reg;
+                    break;
+                case GpuOpcode::Mul:
+                    dst_reg = src1_reg * src2_reg;
+                    break;
+                case GpuOpcode::Div:
+                    dst_reg = (src2_reg == 0) ? 0 : (src1_reg / src2_reg);
+                    break;
+                case GpuOpcode::Mod:
+                    dst_reg = (src2_reg == 0) ? 0 : (src1_reg % src2_reg);
+                    break;
+                case GpuOpcode::Neg:
+                    dst_reg = -src1_reg;
+                    break;
+                case GpuOpcode::Abs:
+                    dst_reg = std::llabs(src1_reg);
+                    break;
+                case GpuOpcode::Dot:
+                    dst_reg = registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 0))] +
+                              registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 1))] +
+                              registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))] * registers[clamp_register_index(static_cast<uint8_t>(src2 + 2))];
+                    break;
+                case GpuOpcode::Cross:
+                {
+                    const auto ax = registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))];
+                    const auto ay = registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))];
+                    const auto az = registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))];
+                    const auto bx = registers[clamp_register_index(static_cast<uint8_t>(src2 + 0))];
+                    const auto by = registers[clamp_register_index(static_cast<uint8_t>(src2 + 1))];
+                    const auto bz = registers[clamp_register_index(static_cast<uint8_t>(src2 + 2))];
+
+                    registers[clamp_register_index(instruction.dst + 0)] = ay * bz - az * by;
+                    registers[clamp_register_index(instruction.dst + 1)] = az * bx - ax * bz;
+                    registers[clamp_register_index(instruction.dst + 2)] = ax * by - ay * bx;
+                    break;
+                }
+                case GpuOpcode::Length:
+                {
+                    const long double x = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))]);
+                    const long double y = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))]);
+                    const long double z = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))]);
+                    dst_reg = static_cast<int64_t>(std::sqrt((x * x) + (y * y) + (z * z)));
+                    break;
+                }
+                case GpuOpcode::Normalize:
+                {
+                    const long double x = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 0))]);
+                    const long double y = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 1))]);
+                    const long double z = static_cast<long double>(registers[clamp_register_index(static_cast<uint8_t>(src1 + 2))]);
+                    const long double length = std::sqrt((x * x) + (y * y) + (z * z));
+                    const long double scale = (length == 0.0L) ? 0.0L : (1.0L / length);
+
+                    registers[clamp_register_index(instruction.dst + 0)] = static_cast<int64_t>(std::llround(x * scale * 1000000.0L));
+                    registers[clamp_register_index(instruction.dst + 1)] = static_cast<int64_t>(std::llround(y * scale * 1000000.0L));
+                    registers[clamp_register_index(instruction.dst + 2)] = static_cast<int64_t>(std::llround(z * scale * 1000000.0L));
+                    break;
+                }
+                case GpuOpcode::Lerp:
+                {
+                    const int64_t factor = static_cast<int64_t>(instruction.immediate & 0xFFFFU);
+                    dst_reg = src1_reg + (((src2_reg - src1_reg) * factor) / 65535);
+                    break;
+                }
+                case GpuOpcode::Clamp:
+                {
+                    const int64_t minimum = src2_reg;
+                    const int64_t maximum = static_cast<int64_t>(instruction.immediate);
+                    dst_reg = std::clamp(src1_reg, minimum, maximum);
+                    break;
+                }
+                case GpuOpcode::Eq:
+                    dst_reg = (src1_reg == src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::Ne:
+                    dst_reg = (src1_reg != src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::Lt:
+                    dst_reg = (src1_reg < src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::Le:
+                    dst_reg = (src1_reg <= src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::Gt:
+                    dst_reg = (src1_reg > src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::Ge:
+                    dst_reg = (src1_reg >= src2_reg) ? 1 : 0;
+                    break;
+                case GpuOpcode::And:
+                    dst_reg = src1_reg & src2_reg;
+                    break;
                 case GpuOpcode::Or:
                     dst_reg = src1_reg | src2_reg;
                     break;
@@ -841,445 +3143,1624 @@ namespace FIAT128
                 case GpuOpcode::UnpackRgba:
                     dst_reg = static_cast<int64_t>(static_cast<uint32_t>(src1_reg));
                     break;
-                case GpuOpcode::Halt:
+                case GpuOpcode::Halt:
+                    return;
+                default:
+                    return;
+                }
+            }
+
+        }
+
+        auto dma_register(size_t reg) -> size_t
+        {
+            return gpu_word_lane(bus.read(true, dma_bus_id, dma_channel, reg), 0);
+        }
+
+        auto set_dma_status(DmaState state) -> void
+        {
+            bus.write(true, dma_bus_id, dma_channel, DmaStatus, std::bitset<word_size>(static_cast<uint32_t>(state)));
+            bus.write(true, dma_bus_id, dma_channel, DmaTransferred, std::bitset<word_size>(dma_transfer.transferred));
+        }
+
+        /**
+         * @brief Latches the transfer registers, faults when either end would leave its module
+         */
+        auto start_dma_transfer() -> void
+        {
+            const size_t control = dma_register(DmaControl);
+
+            DmaTransfer transfer;
+            transfer.source_module = dma_register(DmaSourceModule);
+            transfer.source = dma_register(DmaSourceAddress);
+            transfer.source_stride = std::max<size_t>(1, dma_register(DmaSourceStride));
+            transfer.destination_module = dma_register(DmaDestinationModule);
+            transfer.destination = dma_register(DmaDestinationAddress);
+            transfer.destination_stride = std::max<size_t>(1, dma_register(DmaDestinationStride));
+            transfer.remaining = dma_register(DmaLength);
+            transfer.interrupt_cpu = (control >> 8) & 0xFFU;
+
+            // the last word is first + (remaining - 1) * stride, compared without computing it so it cannot wrap
+            auto fits = [&](size_t module, size_t first, size_t stride)
+            {
+                if (module >= memory_modules)
+                    return false;
+
+                const size_t size = memory[module].size();
+                return first < size && transfer.remaining - 1 <= (size - 1 - first) / stride;
+            };
+
+            transfer.active = transfer.remaining > 0 &&
+                              fits(transfer.source_module, transfer.source, transfer.source_stride) &&
+                              fits(transfer.destination_module, transfer.destination, transfer.destination_stride);
+
+            dma_transfer = transfer;
+            bus.dma_interrupt_targets.store(transfer.active ? dma_interrupt_mask(transfer.interrupt_cpu) : 0, std::memory_order_release);
+            set_dma_status(transfer.active ? DmaState::Busy : DmaState::Fault);
+        }
+
+        /**
+         * @brief Moves the next chunk of the active DMA transfer
+         *
+         * @note unit-stride chunks go through one read_range/write_range pair, so the destination sees a single
+         *       coalesced write event and one module lock per chunk
+         */
+        auto service_dma() -> void
+        {
+            if (!dma_device) [[likely]]
+                return;
+
+            if (dma_device->doorbell.load(std::memory_order_relaxed) && dma_device->doorbell.exchange(false, std::memory_order_acq_rel))
+                start_dma_transfer();
+
+            auto &transfer = dma_transfer;
+            if (!transfer.active)
+                return;
+
+            const size_t chunk = std::min(transfer.remaining, dma_chunk_words);
+            if (transfer.source_stride == 1 && transfer.destination_stride == 1)
+            {
+                bus.write_range(dma_bus_id, transfer.destination_module, transfer.destination, bus.read_range(dma_bus_id, transfer.source_module, transfer.source, chunk));
+            }
+            else
+            {
+                for (size_t i = 0; i < chunk; ++i)
+                {
+                    const auto value = bus.read(true, dma_bus_id, transfer.source_module, transfer.source + i * transfer.source_stride);
+                    bus.write(true, dma_bus_id, transfer.destination_module, transfer.destination + i * transfer.destination_stride, value);
+                }
+            }
+
+            transfer.source += chunk * transfer.source_stride;
+            transfer.destination += chunk * transfer.destination_stride;
+            transfer.remaining -= chunk;
+            transfer.transferred += chunk;
+
+            if (transfer.remaining > 0)
+            {
+                set_dma_status(DmaState::Busy);
+                return;
+            }
+
+            transfer.active = false;
+            bus.dma_interrupt_targets.store(0, std::memory_order_release);
+            set_dma_status(DmaState::Done);
+
+            if (transfer.interrupt_cpu > 0 && transfer.interrupt_cpu <= cores + 1)
+            {
+                auto &cpu = cpus[transfer.interrupt_cpu - 1];
+                cpu.interrupt_enabled = true;
+                cpu.flag.set(CPU::FlagIndex::INTERRUPT);
+                cpu.wake(0);
+            }
+        }
+
+        /**
+         * @brief Services a pending GPU command
+         *
+         * @note returns without touching GPU RAM unless the GPU device saw a command written to word 0
+         */
+        auto execute_gpu_shader() -> void
+        {
+            if constexpr (memory_modules <= 3)
+                return;
+
+            if (!gpu_device->doorbell.load(std::memory_order_relaxed) || !gpu_device->doorbell.exchange(false, std::memory_order_acq_rel))
+                return;
+
+            const auto control_word = bus.read(true, 0, 3, 0);
+            const uint8_t start_byte = static_cast<uint8_t>(gpu_word_lane(control_word, 0) & 0xFFU);
+            if (start_byte == gpu_command_blit || start_byte == gpu_command_shader)
+            {
+                latch_gpu_config();
+                ++gpu_frame;
+            }
+
+            if (start_byte == gpu_command_blit)
+            {
+                execute_gpu_blits();
+                set_word_in_memory(3, 0, std::bitset<word_size>(0));
+                return;
+            }
+
+            if (start_byte != gpu_command_shader)
+                return;
+
+            const auto shader = acquire_gpu_shader();
+            const auto &program = *shader;
+
+            const unsigned int requested_threads = std::max(1U, std::min<unsigned int>(std::thread::hardware_concurrency(), static_cast<unsigned int>(gpu_height)));
+            const size_t rows_per_thread = (gpu_height + static_cast<size_t>(requested_threads) - 1) / static_cast<size_t>(requested_threads);
+            std::vector<std::thread> workers;
+            workers.reserve(requested_threads);
+
+            for (unsigned int thread_index = 0; thread_index < requested_threads; ++thread_index)
+            {
+                const size_t start_row = static_cast<size_t>(thread_index) * rows_per_thread;
+                const size_t end_row = std::min(gpu_height, start_row + rows_per_thread);
+                if (start_row >= end_row)
+                    break;
+
+                workers.emplace_back([&, start_row, end_row]()
+                {
+                    for (size_t y = start_row; y < end_row; ++y)
+                    {
+                        for (size_t x = 0; x < gpu_width; ++x)
+                            execute_gpu_invocation(program, x, y);
+                    }
+                });
+            }
+
+            for (auto &worker : workers)
+                worker.join();
+
+            set_word_in_memory(3, 0, std::bitset<word_size>(0));
+        }
+
+        GpuPixelFormat gpu_pixel_format = GpuPixelFormat::Argb8888;
+        std::vector<uint32_t> gpu_framebuffer;
+        std::vector<uint16_t> gpu_framebuffer_rgb565;
+        std::vector<uint8_t> gpu_framebuffer_indexed;
+        std::array<uint32_t, 256> gpu_palette{};
+        GpuBlendMode gpu_blend_mode = GpuBlendMode::Replace;
+        bool gpu_depth_enabled = false;
+        std::vector<uint32_t> gpu_depth_buffer;
+        static constexpr uint32_t gpu_depth_clear_value = 0xFFFFFFFFU;
+        // bumped by every blit or shader dispatch, keys the ARGB copy get_gpu_framebuffer() hands out for compact formats
+        uint64_t gpu_frame = 0;
+        mutable std::vector<uint32_t> gpu_framebuffer_resolved;
+        mutable uint64_t gpu_framebuffer_resolved_frame = ~0ULL;
+        mutable std::mutex gpu_framebuffer_resolved_mutex;
+        std::vector<uint16_t> gpu_blit_row_rgb565;
+        std::vector<uint8_t> gpu_blit_row_indexed;
+
+        std::list<GpuShaderCacheEntry> gpu_shader_cache;
+        std::shared_ptr<const GpuProgram> gpu_active_shader;
+        size_t gpu_active_shader_generation = 0;
+        GpuShaderCacheStats gpu_shader_cache_stats;
+
+        // identifies this emulator to MemoryMirror, unique across the process
+        uint64_t instance_id = []
+        {
+            static std::atomic<uint64_t> next_instance_id{0};
+            return next_instance_id.fetch_add(1, std::memory_order_relaxed) + 1;
+        }();
+
+        struct BUS
+        {
+
+            struct MemoryWriteLogEntry
+            {
+                size_t sequence = 0;
+                size_t cpu_id = 0;
+                size_t channel = 0;
+                size_t index = 0;
+                std::bitset<word_size> value;
+                size_t count = 1; // range writes log one entry, value holds the first word
+            };
+
+            BUS() = default;
+
+            BUS(Memory (&memory_array)[memory_modules], CPU (&cpu_array)[cores + 1])
+            {
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    memory[i] = &memory_array[i];
+                }
+
+                for (size_t i = 0; i < in_connections; i++)
+                {
+                    in_state[i] = false;
+                }
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    out_state[i] = false;
+                }
+
+                for (size_t i = 0; i < cores; i++)
+                {
+                    cpus[i] = &cpu_array[i];
+                }
+
+                cpus[cores] = &cpu_array[cores];
+            }
+
+            // copy constructor
+            BUS(const BUS &other)
+            {
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    memory[i] = other.memory[i];
+                }
+
+                for (size_t i = 0; i < in_connections; i++)
+                {
+                    in_state[i] = other.in_state[i];
+                }
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    out_state[i] = other.out_state[i];
+                }
+
+                for (size_t i = 0; i < cores; i++)
+                {
+                    cpus[i] = other.cpus[i];
+                }
+
+                cpus[cores] = other.cpus[cores];
+                copy_devices_from(other);
+                active_cores = other.active_cores;
+            }
+
+            // move constructor
+            BUS(BUS &&other) : memory(std::move(other.memory)), in_state(std::move(other.in_state)), out_state(std::move(other.out_state)), cpus(std::move(other.cpus))
+            {
+                copy_devices_from(other);
+                active_cores = other.active_cores;
+            }
+
+            // copy assignment
+            BUS &operator=(const BUS &other)
+            {
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    memory[i] = other.memory[i];
+                }
+
+                for (size_t i = 0; i < in_connections; i++)
+                {
+                    in_state[i] = other.in_state[i];
+                }
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    out_state[i] = other.out_state[i];
+                }
+
+                for (size_t i = 0; i < cores; i++)
+                {
+                    cpus[i] = other.cpus[i];
+                }
+
+                cpus[cores] = other.cpus[cores];
+                copy_devices_from(other);
+                active_cores = other.active_cores;
+                return *this;
+            }
+
+            // move assignment
+            BUS &operator=(BUS &&other) = default;
+
+            auto read(bool memory_operation, size_t id, size_t channel, size_t index) -> std::bitset<word_size>
+            {
+                if (memory_operation) [[likely]]
+                {
+                    if (channel >= channels || index >= memory[channel]->size())
+                        return std::bitset<word_size>(0);
+
+                    auto value = memory[channel]->read(index);
+                    if (devices[channel]) [[unlikely]]
+                        devices[channel]->on_read(id, index, value);
+                    if (is_watched(watched_reads, channel)) [[unlikely]]
+                        record_watch_hits(WatchAccess::Read, id, channel, index, 1);
+
+                    return value;
+                }
+                else if (id == 0)
+                {
+                    if (channel > cores || index >= cache_size)
+                        return std::bitset<word_size>(0);
+
+                    return cpus[channel]->cache[index];
+                }
+
+                return std::bitset<word_size>(0);
+            }
+
+            auto write(bool memory_operation, size_t id, size_t channel, size_t index, std::bitset<word_size> value)
+            {
+                if (memory_operation) [[likely]]
+                {
+                    if (channel >= channels || index >= memory[channel]->size())
+                        return;
+
+                    memory[channel]->write(index, value);
+                    if (devices[channel]) [[unlikely]]
+                        devices[channel]->on_write(id, index, value, 1);
+                    if (is_watched(watched_writes, channel)) [[unlikely]]
+                        record_watch_hits(WatchAccess::Write, id, channel, index, 1);
+                    if (is_watched(parked_channels, channel)) [[unlikely]]
+                        wake_parked_cores(channel, index, 1);
+                    append_memory_write_event(id, channel, index, value);
+                }
+                else
+                {
+                    if (id > cores || index >= cache_size)
+                        return;
+
+                    std::lock_guard<std::mutex> lock(cpu_mutex);
+                    cpus[id]->cache[index] = value;
+                    cpus[id]->note_cache_write();
+                }
+            }
+
+            auto write(bool memory_operation, size_t id, size_t channel, size_t index, unsigned char (&value)[4])
+            {
+                if (memory_operation) [[likely]]
+                {
+                    if (channel >= channels || index >= memory[channel]->size())
+                        return;
+
+                    memory[channel]->write(index, value);
+
+                    auto encoded = (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= (word_size - 32);
+                    if (devices[channel]) [[unlikely]]
+                        devices[channel]->on_write(id, index, encoded, 1);
+                    if (is_watched(watched_writes, channel)) [[unlikely]]
+                        record_watch_hits(WatchAccess::Write, id, channel, index, 1);
+                    if (is_watched(parked_channels, channel)) [[unlikely]]
+                        wake_parked_cores(channel, index, 1);
+                    append_memory_write_event(id, channel, index, encoded);
+                }
+                else
+                {
+                    if (id > cores || index >= cache_size)
+                        return;
+
+                    std::lock_guard<std::mutex> lock(cpu_mutex);
+                    cpus[id]->cache[index] = (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= (word_size - 32);
+                    cpus[id]->note_cache_write();
+                }
+            }
+
+            auto read_range(size_t id, size_t channel, size_t first, size_t count) -> std::vector<std::bitset<word_size>>
+            {
+                std::vector<std::bitset<word_size>> values;
+                if (channel >= channels || first >= memory[channel]->size())
+                    return values;
+
+                memory[channel]->read_range(first, std::min(count, memory[channel]->size() - first), values);
+                if (devices[channel]) [[unlikely]]
+                {
+                    for (size_t i = 0; i < values.size(); ++i)
+                        devices[channel]->on_read(id, first + i, values[i]);
+                }
+                if (is_watched(watched_reads, channel) && !values.empty()) [[unlikely]]
+                    record_watch_hits(WatchAccess::Read, id, channel, first, values.size());
+
+                return values;
+            }
+
+            /**
+             * @brief Writes consecutive words with one lock and one coalesced write event
+             */
+            auto write_range(size_t id, size_t channel, size_t first, const std::vector<std::bitset<word_size>> &values) -> void
+            {
+                if (channel >= channels || first >= memory[channel]->size() || values.empty())
                     return;
-                default:
+
+                const size_t count = std::min(values.size(), memory[channel]->size() - first);
+                memory[channel]->write_range(first, values.data(), count);
+                if (devices[channel]) [[unlikely]]
+                {
+                    for (size_t i = 0; i < count; ++i)
+                        devices[channel]->on_write(id, first + i, values[i], 1);
+                }
+                if (is_watched(watched_writes, channel)) [[unlikely]]
+                    record_watch_hits(WatchAccess::Write, id, channel, first, count);
+                if (is_watched(parked_channels, channel)) [[unlikely]]
+                    wake_parked_cores(channel, first, count);
+                append_memory_write_event(id, channel, first, values.front(), count);
+            }
+
+            /**
+             * @brief Fills consecutive words with one lock and one coalesced write event
+             */
+            auto fill_range(size_t id, size_t channel, size_t first, size_t count, const std::bitset<word_size> &value) -> void
+            {
+                if (channel >= channels || first >= memory[channel]->size() || count == 0)
+                    return;
+
+                count = std::min(count, memory[channel]->size() - first);
+                memory[channel]->fill_range(first, count, value);
+                if (devices[channel]) [[unlikely]]
+                    devices[channel]->on_write(id, first, value, count);
+                if (is_watched(watched_writes, channel)) [[unlikely]]
+                    record_watch_hits(WatchAccess::Write, id, channel, first, count);
+                if (is_watched(parked_channels, channel)) [[unlikely]]
+                    wake_parked_cores(channel, first, count);
+                append_memory_write_event(id, channel, first, value, count);
+            }
+
+            auto subscribe_memory_writes(const MemoryWriteFilter &filter, size_t capacity, WriteDropPolicy policy) -> MemoryWriteSubscription
+            {
+                static std::atomic<MemoryWriteSubscription> next_token{0};
+                auto subscriber = std::make_shared<MemoryWriteSubscriber>(filter, capacity, policy);
+                subscriber->token = next_token.fetch_add(1, std::memory_order_relaxed) + 1;
+
+                std::lock_guard<std::mutex> lock(subscription_mutex);
+                auto table = std::make_shared<SubscriberTable>(*memory_write_subscribers);
+                table->push_back(subscriber);
+                publish_subscriber_table(std::move(table));
+
+                return subscriber->token;
+            }
+
+            auto unsubscribe_memory_writes(MemoryWriteSubscription token) -> void
+            {
+                std::lock_guard<std::mutex> lock(subscription_mutex);
+                auto table = std::make_shared<SubscriberTable>(*memory_write_subscribers);
+                const auto removed = std::remove_if(table->begin(), table->end(), [token](const auto &subscriber)
+                                                    { return subscriber->token == token; });
+                if (removed == table->end())
+                    return;
+
+                table->erase(removed, table->end());
+                publish_subscriber_table(std::move(table));
+            }
+
+            /**
+             * @brief Drains the queue of one subscriber
+             *
+             * @note returns std::nullopt when the token does not belong to this BUS, so the caller can resubscribe
+             */
+            auto poll_memory_writes(MemoryWriteSubscription token) -> std::optional<std::vector<MemoryWriteLogEntry>>
+            {
+                const auto subscriber = find_memory_write_subscriber(token);
+                if (!subscriber)
+                    return std::nullopt;
+
+                std::vector<MemoryWriteLogEntry> events;
+                uint64_t skipped = 0;
+                const uint64_t cursor = subscriber->queue.collect_since(subscriber->cursor.load(std::memory_order_relaxed), events, skipped);
+                subscriber->cursor.store(cursor, std::memory_order_release);
+                subscriber->skipped.fetch_add(skipped, std::memory_order_relaxed);
+                return events;
+            }
+
+            auto dropped_memory_writes(MemoryWriteSubscription token) const -> size_t
+            {
+                const auto subscriber = find_memory_write_subscriber(token);
+                if (!subscriber)
+                    return 0;
+
+                return static_cast<size_t>(subscriber->skipped.load(std::memory_order_relaxed) + subscriber->rejected.load(std::memory_order_relaxed) + subscriber->queue.lapped());
+            }
+
+            auto add_watchpoint(const Watchpoint &watch) -> WatchpointId
+            {
+                if (watch.channel >= channels || watch.channel >= 64 || watch.first_index > watch.last_index ||
+                    (static_cast<uint8_t>(watch.access) & static_cast<uint8_t>(WatchAccess::ReadWrite)) == 0)
+                    return 0;
+
+                std::lock_guard<std::mutex> lock(watch_mutex);
+                auto table = std::make_shared<WatchTable>(*watchpoints);
+                table->push_back({++next_watchpoint_id, watch});
+                publish_watch_table(std::move(table));
+                return next_watchpoint_id;
+            }
+
+            auto remove_watchpoint(WatchpointId id) -> bool
+            {
+                std::lock_guard<std::mutex> lock(watch_mutex);
+                auto table = std::make_shared<WatchTable>(*watchpoints);
+                const auto removed = std::remove_if(table->begin(), table->end(), [id](const auto &armed)
+                                                    { return armed.id == id; });
+                if (removed == table->end())
+                    return false;
+
+                table->erase(removed, table->end());
+                publish_watch_table(std::move(table));
+                return true;
+            }
+
+            /**
+             * @brief True when reads on channel reach a device that hooks them or an armed read watchpoint
+             */
+            auto reads_are_observed(size_t channel) const -> bool
+            {
+                return (channel < memory_modules && devices[channel] && devices[channel]->observes_reads()) || is_watched(watched_reads, channel);
+            }
+
+            /**
+             * @brief Recomputes the channels parked cores wait on, called when a core parks or resumes
+             */
+            auto refresh_parked_channels() -> void
+            {
+                // serialized, so the last refresh sees every core that parked or resumed before it
+                std::lock_guard<std::mutex> lock(parked_channels_mutex);
+
+                uint64_t channels_mask = 0;
+                for (size_t i = 0; i <= cores; i++)
+                {
+                    const auto &cpu = *cpus[i];
+                    if (!cpu.parked.load(std::memory_order_acquire))
+                        continue;
+
+                    const size_t read_count = cpu.parked_read_count.load(std::memory_order_relaxed);
+                    for (size_t read = 0; read < read_count; ++read)
+                    {
+                        // past the mask every channel counts as waited on
+                        const size_t module = cpu.parked_reads[read].module.load(std::memory_order_relaxed);
+                        channels_mask |= module < 64 ? uint64_t(1) << module : ~uint64_t(0);
+                    }
+                }
+
+                parked_channels.store(channels_mask, std::memory_order_release);
+            }
+
+            /**
+             * @brief Wakes the parked cores that read a word in [first, first + count) of channel
+             */
+            auto wake_parked_cores(size_t channel, size_t first, size_t count) -> void
+            {
+                for (size_t i = 0; i <= cores; i++)
+                {
+                    auto &cpu = *cpus[i];
+                    if (!cpu.parked.load(std::memory_order_acquire))
+                        continue;
+
+                    const size_t read_count = cpu.parked_read_count.load(std::memory_order_relaxed);
+                    for (size_t read = 0; read < read_count; ++read)
+                    {
+                        const auto &parked_read = cpu.parked_reads[read];
+                        const size_t address = parked_read.address.load(std::memory_order_relaxed);
+                        if (parked_read.module.load(std::memory_order_relaxed) == channel && address >= first && address - first < count)
+                            cpu.wake(parked_read.offset.load(std::memory_order_relaxed));
+                    }
+                }
+            }
+
+            // one bit per channel a parked core waits on
+            std::atomic<uint64_t> parked_channels{0};
+            std::mutex parked_channels_mutex;
+
+            // cores a requested or running DMA transfer will interrupt, they step their loops instead of skipping them
+            std::atomic<uint64_t> dma_interrupt_targets{0};
+
+            auto set_core_active(size_t id, bool active) -> void
+            {
+                if (id <= cores)
+                    active_cores.set(id, active);
+            }
+
+            // cores with HALT clear, the only ones run() steps
+            std::bitset<cores + 1> active_cores;
+
+            static constexpr size_t watch_hit_capacity = 1024;
+
+            // lock-free hit buffer, producers are the accessing CPU threads
+            AtomicRing<WatchHit> watch_hits{watch_hit_capacity};
+
+            /**
+             * @brief Turns the event ring behind the get_memory_write_events_since view on or off
+             */
+            auto record_memory_writes(bool enabled) -> void
+            {
+                memory_write_recording.store(enabled, std::memory_order_release);
+            }
+
+            auto get_memory_write_events_since(size_t last_sequence) const -> std::vector<MemoryWriteLogEntry>
+            {
+                std::vector<MemoryWriteLogEntry> events;
+                memory_write_log.collect_since(last_sequence, events);
+                return events;
+            }
+
+            auto latest_memory_write_sequence() const -> size_t
+            {
+                return memory_write_log.latest();
+            }
+
+            auto dropped_memory_write_events() const -> size_t
+            {
+                return memory_write_log.dropped();
+            }
+
+            size_t in_connections = cores;
+            size_t channels = memory_modules;
+
+            bool in_state[(cores > 0) ? cores : 1];
+            bool out_state[memory_modules];
+
+            Memory *memory[memory_modules];
+            CPU *cpus[cores + 1];
+
+            static constexpr size_t memory_write_log_capacity = 512;
+            AtomicRing<MemoryWriteLogEntry> memory_write_log{memory_write_log_capacity};
+            // on by default, callers that only subscribe can turn the ring off
+            std::atomic<bool> memory_write_recording{true};
+
+            std::mutex cpu_mutex;
+
+            auto attach_device(size_t channel, std::shared_ptr<Device> device) -> void
+            {
+                if (channel >= memory_modules)
                     return;
+
+                devices[channel] = device.get();
+                device_owners[channel] = std::move(device);
+            }
+
+            // dispatch table, nullptr keeps the channel on the plain RAM path
+            Device *devices[memory_modules]{};
+            std::shared_ptr<Device> device_owners[memory_modules];
+
+        private:
+            struct MemoryWriteSubscriber
+            {
+                MemoryWriteSubscriber(const MemoryWriteFilter &write_filter, size_t capacity, WriteDropPolicy drop_policy)
+                    : filter(write_filter), policy(drop_policy), queue(capacity) {}
+
+                auto offer(const MemoryWriteLogEntry &entry) -> void
+                {
+                    if (policy == WriteDropPolicy::DropNewest && queue.latest() - cursor.load(std::memory_order_acquire) >= queue.capacity())
+                    {
+                        rejected.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    // each queue numbers its own entries, so a consumer sees its gaps
+                    MemoryWriteLogEntry queued = entry;
+                    queued.sequence = static_cast<size_t>(queue.claim());
+                    queue.publish(queued.sequence, queued);
+                }
+
+                MemoryWriteSubscription token = 0;
+                MemoryWriteFilter filter;
+                WriteDropPolicy policy;
+                AtomicRing<MemoryWriteLogEntry> queue;
+                std::atomic<uint64_t> cursor{0};
+                std::atomic<uint64_t> skipped{0};
+                std::atomic<uint64_t> rejected{0};
+            };
+
+            using SubscriberTable = std::vector<std::shared_ptr<MemoryWriteSubscriber>>;
+
+            auto find_memory_write_subscriber(MemoryWriteSubscription token) const -> std::shared_ptr<MemoryWriteSubscriber>
+            {
+                const auto table = subscriber_table();
+                for (const auto &subscriber : *table)
+                {
+                    if (subscriber->token == token)
+                        return subscriber;
                 }
+
+                return nullptr;
             }
 
-        }
+            // copy-on-write table swapped under subscription_mutex, writers only take it while someone is subscribed
+            std::shared_ptr<const SubscriberTable> memory_write_subscribers = std::make_shared<const SubscriberTable>();
+            std::atomic<size_t> memory_write_subscriber_count{0};
+            mutable std::mutex subscription_mutex;
 
-        auto execute_gpu_shader() -> void
-        {
-            if constexpr (memory_modules <= 3)
-                return;
+            auto subscriber_table() const -> std::shared_ptr<const SubscriberTable>
+            {
+                std::lock_guard<std::mutex> lock(subscription_mutex);
+                return memory_write_subscribers;
+            }
 
-            ensure_gpu_framebuffer();
+            // called with subscription_mutex held
+            auto publish_subscriber_table(std::shared_ptr<const SubscriberTable> table) -> void
+            {
+                const size_t count = table->size();
+                memory_write_subscribers = std::move(table);
+                memory_write_subscriber_count.store(count, std::memory_order_release);
+            }
 
-            const auto control_word = bus.read(true, 0, 3, 0);
-            const uint8_t start_byte = static_cast<uint8_t>(control_word.to_ullong() & 0xFFU);
-            if (start_byte != 0xFFU)
-                return;
+            struct ArmedWatchpoint
+            {
+                WatchpointId id = 0;
+                Watchpoint watch;
+            };
 
-            const unsigned int requested_threads = std::max(1U, std::min<unsigned int>(std::thread::hardware_concurrency(), static_cast<unsigned int>(gpu_height)));
-            const size_t rows_per_thread = (gpu_height + static_cast<size_t>(requested_threads) - 1) / static_cast<size_t>(requested_threads);
-            std::vector<std::thread> workers;
-            workers.reserve(requested_threads);
+            using WatchTable = std::vector<ArmedWatchpoint>;
 
-            for (unsigned int thread_index = 0; thread_index < requested_threads; ++thread_index)
+            // one bit per channel, the only cost of the watchpoint path while nothing is armed
+            std::atomic<uint64_t> watched_reads{0};
+            std::atomic<uint64_t> watched_writes{0};
+            // copy-on-write table swapped under watch_mutex, only read once a watched channel is accessed
+            std::shared_ptr<const WatchTable> watchpoints = std::make_shared<const WatchTable>();
+            WatchpointId next_watchpoint_id = 0;
+            mutable std::mutex watch_mutex;
+
+            static auto is_watched(const std::atomic<uint64_t> &mask, size_t channel) -> bool
             {
-                const size_t start_row = static_cast<size_t>(thread_index) * rows_per_thread;
-                const size_t end_row = std::min(gpu_height, start_row + rows_per_thread);
-                if (start_row >= end_row)
-                    break;
+                return channel < 64 && ((mask.load(std::memory_order_relaxed) >> channel) & 1U);
+            }
 
-                workers.emplace_back([&, start_row, end_row]()
+            auto watch_table() const -> std::shared_ptr<const WatchTable>
+            {
+                std::lock_guard<std::mutex> lock(watch_mutex);
+                return watchpoints;
+            }
+
+            // called with watch_mutex held
+            auto publish_watch_table(std::shared_ptr<const WatchTable> table) -> void
+            {
+                uint64_t reads = 0;
+                uint64_t writes = 0;
+                for (const auto &armed : *table)
                 {
-                    for (size_t y = start_row; y < end_row; ++y)
+                    if (static_cast<uint8_t>(armed.watch.access) & static_cast<uint8_t>(WatchAccess::Read))
+                        reads |= uint64_t(1) << armed.watch.channel;
+                    if (static_cast<uint8_t>(armed.watch.access) & static_cast<uint8_t>(WatchAccess::Write))
+                        writes |= uint64_t(1) << armed.watch.channel;
+                }
+
+                watchpoints = std::move(table);
+                watched_reads.store(reads, std::memory_order_release);
+                watched_writes.store(writes, std::memory_order_release);
+            }
+
+            auto record_watch_hits(WatchAccess access, size_t cpu_id, size_t channel, size_t index, size_t count) -> void
+            {
+                const auto table = watch_table();
+                for (const auto &armed : *table)
+                {
+                    const auto &watch = armed.watch;
+                    if (watch.channel != channel || (static_cast<uint8_t>(watch.access) & static_cast<uint8_t>(access)) == 0 ||
+                        index > watch.last_index || index + count <= watch.first_index)
+                        continue;
+
+                    WatchHit hit;
+                    hit.watchpoint = armed.id;
+                    hit.cpu_id = cpu_id;
+                    if (cpu_id <= cores && cpus[cpu_id])
                     {
-                        for (size_t x = 0; x < gpu_width; ++x)
-                            execute_gpu_invocation(x, y);
+                        hit.pc = cpus[cpu_id]->stack_pointer.to_ulong();
+                        hit.cycle = static_cast<uint64_t>(cpus[cpu_id]->total_cpu_cycles);
                     }
-                });
+                    hit.channel = channel;
+                    hit.index = index;
+                    hit.count = count;
+                    hit.access = access;
+                    watch_hits.push(hit);
+                }
             }
 
-            for (auto &worker : workers)
-                worker.join();
+            auto copy_devices_from(const BUS &other) -> void
+            {
+                for (size_t i = 0; i < memory_modules; i++)
+                {
+                    devices[i] = other.devices[i];
+                    device_owners[i] = other.device_owners[i];
+                }
+            }
 
-            set_word_in_memory(3, 0, std::bitset<word_size>(0));
-        }
+            auto append_memory_write_event(size_t cpu_id, size_t channel, size_t index, const std::bitset<word_size> &value, size_t count = 1) -> void
+            {
+                const bool recording = memory_write_recording.load(std::memory_order_relaxed);
+                const bool subscribed = memory_write_subscriber_count.load(std::memory_order_acquire) != 0;
+                if (!recording && !subscribed) [[likely]]
+                    return;
 
-        std::vector<uint32_t> gpu_framebuffer;
+                MemoryWriteLogEntry entry{0, cpu_id, channel, index, value, count};
+                if (recording)
+                {
+                    const uint64_t sequence = memory_write_log.claim();
+                    entry.sequence = static_cast<size_t>(sequence);
+                    memory_write_log.publish(sequence, entry);
+                }
 
-        struct BUS
+                if (!subscribed)
+                    return;
+
+                const auto table = subscriber_table();
+                for (const auto &subscriber : *table)
+                {
+                    if (subscriber->filter.matches(cpu_id, channel, index, count))
+                        subscriber->offer(entry);
+                }
+            }
+        };
+
+        struct CPU
         {
 
-            struct MemoryWriteLogEntry
+            CPU(BUS *extern_bus = nullptr) : bus(extern_bus)
             {
-                size_t sequence = 0;
-                size_t cpu_id = 0;
-                size_t channel = 0;
-                size_t index = 0;
-                std::bitset<word_size> value;
-            };
+                id = id_counter++;
+                bus = extern_bus;
+                decrement(stack_pointer);
+                load_timer(~std::bitset<word_size>());
+
+                if (id == 0)
+                    flag.reset(FlagIndex::OVERFLOW);
+                else
+                    set_halted(true);
+            }
+
+            /**
+             * @brief The only place HALT changes, keeps the active-core set of the BUS in step
+             */
+            auto set_halted(bool halted) -> void
+            {
+                unpark();
+                flag.set(FlagIndex::HALT, halted);
+                if (bus)
+                    bus->set_core_active(id, !halted);
+            }
+
+            auto is_halted() const -> bool
+            {
+                return flag.test(FlagIndex::HALT);
+            }
+
+            auto set_bus(BUS *extern_bus) -> void
+            {
+                this->bus = extern_bus;
+            }
+
+            // bitset<word_size> increment
+            template <size_t bitset_size>
+            auto increment(std::bitset<bitset_size> &value) -> void
+            {
+                if (is_bitset_ones(value)) [[unlikely]]
+                {
+                    value.reset();
+                    flag.set(FlagIndex::OVERFLOW);
+                    return;
+                }
+
+                if constexpr (fits_native_word<bitset_size>)
+                {
+                    value = std::bitset<bitset_size>(value.to_ullong() + 1);
+                    return;
+                }
+
+                for (size_t i = 0; i < bitset_size; i++)
+                {
+                    if (value[i] == 0)
+                    {
+                        value.set(i);
+                        break;
+                    }
+
+                    value.reset(i);
+                }
+            }
+
+            // bitset<word_size> decrement
+            template <size_t bitset_size>
+            auto decrement(std::bitset<bitset_size> &value) -> void
+            {
+                if (is_bitset_zero(value)) [[unlikely]]
+                {
+                    value = ~value;
+                    flag.set(FlagIndex::OVERFLOW);
+                    return;
+                }
+                for (size_t i = 0; i < bitset_size; i++)
+                {
+                    if (value[i] == 0)
+                    {
+                        value.set(i);
+                    }
+                    else
+                    {
+                        value.reset(i);
+                        break;
+                    }
+                }
+            }
+
+            // execute instruction
+            auto execute_instruction(bool step_mode = 0) -> void
+            {
+                if (!this->bus)
+                {
+                    std::cerr << "Bus not connected" << std::endl;
+                    return;
+                }
+
+                if (id == 0 && !initialized) [[unlikely]]
+                {
+                    if (flag[FlagIndex::OVERFLOW] == 1) [[unlikely]]
+                    {
+                        flag.reset(FlagIndex::OVERFLOW);
+                        initialized = true;
+                        goto emerg_break;
+                    }
+
+                    total_cpu_cycles++;
+
+                    cache[stack_pointer.to_ulong()] = bus->read(true, id, 0, stack_pointer.to_ulong());
+                    forget_decoded(stack_pointer.to_ulong());
+
+                    decrement(stack_pointer);
+                    tick_timer();
+                    return;
+                }
+                else
+                {
+                emerg_break:
+
+                    if (is_halted())
+                    {
+                        debug_print(std::string("CPU ").append(std::to_string(id)), " halted");
+                        return;
+                    }
+
+                    if (is_parked()) [[unlikely]]
+                    {
+                        const size_t parked_cycles = step_mode ? 1 : cycles_per_instruction();
+                        for (size_t cycle = 0; cycle < parked_cycles && is_parked(); ++cycle)
+                        {
+                            if (park_phase > 0 && woken_before_read())
+                                resume_mid_iteration();
+                            else if (park_phase == 0 && park_should_end())
+                                unpark();
+                            else
+                                parked_cycle();
+                        }
+
+                        if (is_parked())
+                            return;
+                    }
 
-            BUS() = default;
+                    if (interrupt_enabled && new_instruction) [[unlikely]]
+                    {
+                        interrupt_enabled = false;
+                        flag.reset(FlagIndex::INTERRUPT);
+                        stack_pointer = interrupt_seg_index;
+                    }
 
-            BUS(Memory (&memory_array)[memory_modules], CPU (&cpu_array)[cores + 1])
-            {
-                for (size_t i = 0; i < memory_modules; i++)
-                {
-                    memory[i] = &memory_array[i];
-                }
+                    if (new_instruction)
+                        new_instruction = false;
 
-                for (size_t i = 0; i < in_connections; i++)
-                {
-                    in_state[i] = false;
-                }
-                for (size_t i = 0; i < memory_modules; i++)
-                {
-                    out_state[i] = false;
-                }
+                    execute_cycle(!step_mode);
 
-                for (size_t i = 0; i < cores; i++)
-                {
-                    cpus[i] = &cpu_array[i];
+                    // outside step mode the fetch is followed by the remaining cycles of the instruction
+                    if (!step_mode && instruction_cycle == 1)
+                    {
+                        for (size_t i = 1; i < to_size_t(current_instruction.cycles) && instruction_cycle == 1; i++)
+                            execute_cycle(true, fuse_instructions);
+                    }
                 }
-
-                cpus[cores] = &cpu_array[cores];
             }
 
-            // copy constructor
-            BUS(const BUS &other)
+            /**
+             * @brief Runs the fetch or the execute cycle of the current instruction
+             *
+             * @note step mode fetches decode the cache word directly, only whole-instruction runs go through the
+             *       pre-decoded slots and their generation check
+             */
+            auto execute_cycle(bool predecoded = false, bool may_fuse = false) -> void
             {
-                for (size_t i = 0; i < memory_modules; i++)
+                if (timer_expired()) [[unlikely]]
                 {
-                    memory[i] = other.memory[i];
+                    interrupt_enabled = true;
+                    flag.set(FlagIndex::INTERRUPT);
                 }
 
-                for (size_t i = 0; i < in_connections; i++)
+                total_cpu_cycles++;
+
+                if (instruction_cycle == 0)
                 {
-                    in_state[i] = other.in_state[i];
+                    instruction_cycle = 1;
+
+                    // fetch instruction
+                    const size_t pc = stack_pointer.to_ulong();
+                    current_word = cache[pc];
+
+                    if (predecoded)
+                    {
+                        const auto &slot = decoded_slot(pc);
+                        current_instruction = slot.instruction;
+                        acc = slot.encoded;
+                    }
+                    else
+                    {
+                        acc = to_xbits<32>(current_word);
+                        current_instruction = decode_instruction(acc);
+                    }
                 }
-                for (size_t i = 0; i < memory_modules; i++)
+                else
                 {
-                    out_state[i] = other.out_state[i];
-                }
+                    instruction_cycle = 0;
+                    size_t pc = stack_pointer.to_ulong();
 
-                for (size_t i = 0; i < cores; i++)
-                {
-                    cpus[i] = other.cpus[i];
+                    // execute instruction
+                    (this->*current_instruction.opcode)();
+
+                    if (may_fuse && can_fuse(pc)) [[unlikely]]
+                        pc = run_fused_partner(pc);
+
+                    new_instruction = true;
+
+                    // execution runs down the cache, a jump upwards closes a loop
+                    const bool back_edge = stack_pointer.to_ulong() > pc;
+                    decrement(stack_pointer);
+                    if (back_edge) [[unlikely]]
+                        on_back_edge(pc);
                 }
 
-                cpus[cores] = other.cpus[cores];
+                tick_timer();
             }
 
-            // move constructor
-            BUS(BUS &&other) : memory(std::move(other.memory)), in_state(std::move(other.in_state)), out_state(std::move(other.out_state)), cpus(std::move(other.cpus)) {}
-
-            // copy assignment
-            BUS &operator=(const BUS &other)
+            /**
+             * @brief Parks the core when a loop iteration ended in the state it started from
+             *
+             * @note an iteration qualifies when it made no stores, no INT or HLT, and read at most max_spin_reads memory
+             *       words that still hold the values it saw. Rerunning it can then only repeat itself until one of those
+             *       words is written, so the core just counts cycles until then
+             */
+            auto on_back_edge(size_t branch) -> void
             {
-                for (size_t i = 0; i < memory_modules; i++)
+                fold_flags();
+                if (!park_spinning)
                 {
-                    memory[i] = other.memory[i];
+                    if (accelerate_loops) [[unlikely]]
+                        fast_forward_counted_loop(branch);
+                    return;
                 }
 
-                for (size_t i = 0; i < in_connections; i++)
-                {
-                    in_state[i] = other.in_state[i];
-                }
-                for (size_t i = 0; i < memory_modules; i++)
-                {
-                    out_state[i] = other.out_state[i];
-                }
+                const bool code_changed = cache_written.load(std::memory_order_relaxed) && cache_written.exchange(false, std::memory_order_acq_rel);
+                const bool fixpoint = spin_branch == branch && spin_pure && !code_changed && !interrupt_enabled && cycles_per_instruction() != 0 &&
+                                      spin_stack_pointer == stack_pointer && spin_flag == flag &&
+                                      std::equal(std::begin(reg), std::end(reg), std::begin(spin_reg));
 
-                for (size_t i = 0; i < cores; i++)
+                // the reads of this iteration are the words the parked core waits on, they are checked again once the
+                // park is published so a write racing with it either sees the parked core or changes a read value
+                if (fixpoint && spin_reads_unchanged())
                 {
-                    cpus[i] = other.cpus[i];
+                    park(static_cast<uint64_t>(total_cpu_cycles - spin_cycle));
+                    if (spin_reads_unchanged())
+                        return;
+
+                    unpark();
                 }
 
-                cpus[cores] = other.cpus[cores];
-                return *this;
+                if (accelerate_loops) [[unlikely]]
+                    fast_forward_counted_loop(branch);
+
+                spin_branch = branch;
+                spin_cycle = total_cpu_cycles;
+                spin_stack_pointer = stack_pointer;
+                spin_flag = flag;
+                std::copy(std::begin(reg), std::end(reg), std::begin(spin_reg));
+                spin_pure = true;
+                spin_read_count = 0;
             }
 
-            // move assignment
-            BUS &operator=(BUS &&other) = default;
+            /**
+             * @brief Whether the second half of the pair at pc can run in the dispatch of the first
+             *
+             * @note the second half has to start as it would after a fetch of its own: no interrupt taken between the
+             *       halves, no timer expiry or wrap in its cycles and no DMA completion queued for this core
+             */
+            auto can_fuse(size_t pc) const -> bool
+            {
+                const auto &slot = decoded_cache[pc];
+                return slot.fused != FusedPair::None && slot.generation == code_generation.load(std::memory_order_acquire) &&
+                       !interrupt_enabled && timer_deadline - timer_ticks > 2 &&
+                       !(bus && (bus->dma_interrupt_targets.load(std::memory_order_acquire) & dma_interrupt_mask(id + 1)));
+            }
 
-            auto read(bool memory_operation, size_t id, size_t channel, size_t index) -> std::bitset<word_size>
+            /**
+             * @brief Retires the first half of a fused pair and runs the second, returns the second half's address
+             *
+             * @note the cycles and timer ticks between the halves are the ones a separate fetch would have taken, so
+             *       total_cpu_cycles and the timer end up as if the pair had been dispatched twice
+             */
+            auto run_fused_partner(size_t pc) -> size_t
             {
-                if (memory_operation) [[likely]]
-                {
-                    if (channel >= channels || index >= memory[channel]->memory.size())
-                        return std::bitset<word_size>(0);
+                const auto &slot = decoded_cache[pc];
 
-                    return memory[channel]->read(index);
-                }
-                else if (id == 0)
-                {
-                    if (channel > cores || index >= cache_size)
-                        return std::bitset<word_size>(0);
+                decrement(stack_pointer);
+                tick_timer();
 
-                    return cpus[channel]->cache[index];
+                total_cpu_cycles++;
+                current_word = cache[pc - 1];
+                current_instruction = slot.partner;
+                acc = slot.partner_encoded;
+                tick_timer();
+
+                total_cpu_cycles++;
+                switch (slot.fused)
+                {
+                case FusedPair::CompareBranchZero:
+                case FusedPair::AddBranchZero:
+                    BIZ();
+                    break;
+                case FusedPair::CompareBranchSign:
+                case FusedPair::AddBranchSign:
+                    BIN();
+                    break;
+                case FusedPair::MemoryMove:
+                    STA();
+                    break;
+                case FusedPair::None:
+                    break;
                 }
 
-                return std::bitset<word_size>(0);
+                return pc - 1;
             }
 
-            auto write(bool memory_operation, size_t id, size_t channel, size_t index, std::bitset<word_size> value)
+            auto note_spin_read(size_t module, size_t address, const std::bitset<word_size> &value) -> void
             {
-                if (memory_operation) [[likely]]
-                {
-                    if (channel >= channels || index >= memory[channel]->memory.size())
-                        return;
-
-                    memory[channel]->write(index, value);
-                    append_memory_write_event(id, channel, index, value);
-                }
+                if (spin_read_count < max_spin_reads)
+                    spin_reads[spin_read_count++] = {module, address, value, static_cast<uint64_t>(total_cpu_cycles - spin_cycle)};
                 else
-                {
-                    if (id > cores || index >= cache_size)
-                        return;
-
-                    std::lock_guard<std::mutex> lock(cpu_mutex);
-                    cpus[id]->cache[index] = value;
-                }
+                    spin_pure = false;
             }
 
-            auto write(bool memory_operation, size_t id, size_t channel, size_t index, unsigned char (&value)[4])
+            auto spin_reads_unchanged() -> bool
             {
-                if (memory_operation) [[likely]]
+                for (size_t i = 0; i < spin_read_count; ++i)
                 {
-                    if (channel >= channels || index >= memory[channel]->memory.size())
-                        return;
-
-                    memory[channel]->write(index, value);
-
-                    auto encoded = (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= 96;
-                    append_memory_write_event(id, channel, index, encoded);
+                    const auto &read = spin_reads[i];
+                    if (read.module >= memory_modules || read.module >= 64 || bus->reads_are_observed(read.module) ||
+                        bus->memory[read.module]->read(read.address) != read.value)
+                        return false;
                 }
-                else
-                {
-                    if (id > cores || index >= cache_size)
-                        return;
 
-                    std::lock_guard<std::mutex> lock(cpu_mutex);
-                    cpus[id]->cache[index] = (std::bitset<word_size>(u32(value[0]) << 24 | u32(value[1]) << 16 | u32(value[2]) << 8 | u32(value[3]))) <<= 96;
-                }
+                return true;
             }
 
-            auto get_memory_write_events_since(size_t last_sequence) const -> std::vector<MemoryWriteLogEntry>
+            auto park(uint64_t period) -> void
             {
-                std::lock_guard<std::mutex> lock(memory_write_log_mutex);
-                std::vector<MemoryWriteLogEntry> events;
+                if (period == 0)
+                    return;
 
-                for (const auto &entry : memory_write_log)
+                for (size_t i = 0; i < spin_read_count; ++i)
                 {
-                    if (entry.sequence > last_sequence)
-                        events.push_back(entry);
+                    parked_reads[i].module.store(spin_reads[i].module, std::memory_order_relaxed);
+                    parked_reads[i].address.store(spin_reads[i].address, std::memory_order_relaxed);
+                    parked_reads[i].offset.store(spin_reads[i].offset, std::memory_order_relaxed);
                 }
+                parked_read_count.store(spin_read_count, std::memory_order_relaxed);
 
-                return events;
+                park_period = period;
+                park_phase = 0;
+                park_wake_offset.store(no_wake_offset, std::memory_order_relaxed);
+                park_wake.store(false, std::memory_order_relaxed);
+
+                // publishes the reads above to the writer threads that test parked in BUS::wake_parked_cores
+                parked.store(true, std::memory_order_release);
+                bus->refresh_parked_channels();
             }
 
-            auto latest_memory_write_sequence() const -> size_t
+            auto unpark() -> void
             {
-                std::lock_guard<std::mutex> lock(memory_write_log_mutex);
-                return memory_write_sequence;
-            }
+                if (!is_parked())
+                    return;
 
-            size_t in_connections = cores;
-            size_t channels = memory_modules;
+                parked.store(false, std::memory_order_release);
+                spin_branch = no_spin_branch;
+                bus->refresh_parked_channels();
+            }
 
-            bool in_state[(cores > 0) ? cores : 1];
-            bool out_state[memory_modules];
+            auto is_parked() const -> bool
+            {
+                return parked.load(std::memory_order_relaxed);
+            }
 
-            Memory *memory[memory_modules];
-            CPU *cpus[cores + 1];
+            /**
+             * @brief Called from writer threads, offset is the cycle of the iteration that reads the written word
+             */
+            auto wake(uint64_t offset) -> void
+            {
+                uint64_t earliest = park_wake_offset.load(std::memory_order_relaxed);
+                while (offset < earliest && !park_wake_offset.compare_exchange_weak(earliest, offset, std::memory_order_relaxed))
+                {
+                }
 
-            std::deque<MemoryWriteLogEntry> memory_write_log;
-            size_t memory_write_sequence = 0;
-            mutable std::mutex memory_write_log_mutex;
+                park_wake.store(true, std::memory_order_release);
+            }
 
-            std::mutex cpu_mutex;
+            /**
+             * @brief True when a write landed before the point of the current iteration that reads the written word
+             */
+            auto woken_before_read() const -> bool
+            {
+                return park_wake.load(std::memory_order_acquire) && park_phase < park_wake_offset.load(std::memory_order_relaxed);
+            }
 
-        private:
-            auto append_memory_write_event(size_t cpu_id, size_t channel, size_t index, const std::bitset<word_size> &value) -> void
+            /**
+             * @brief Resumes a core woken mid-iteration as if it had stepped the loop
+             *
+             * @note a stepping core would see the write in this iteration. The part of the iteration before the read is
+             *       pure and read only unchanged words, so rerunning it from the loop head costs the same cycles, the
+             *       counters are wound back to the head to keep the totals of a stepping core
+             */
+            auto resume_mid_iteration() -> void
             {
-                std::lock_guard<std::mutex> lock(memory_write_log_mutex);
-                ++memory_write_sequence;
+                total_cpu_cycles -= static_cast<long long>(park_phase);
+                timer_ticks -= park_phase;
+                park_phase = 0;
+                unpark();
+            }
 
-                memory_write_log.push_back({memory_write_sequence, cpu_id, channel, index, value});
-                if (memory_write_log.size() > 512)
-                    memory_write_log.pop_front();
+            /**
+             * @brief A parked core resumes at an iteration boundary once a read word or its cache was written, or when
+             *        the timer reaches zero within the next iteration so the interrupt lands on the exact cycle
+             */
+            auto park_should_end() const -> bool
+            {
+                return park_wake.load(std::memory_order_acquire) || cache_written.load(std::memory_order_acquire) ||
+                       (timer_deadline != no_timer_deadline && timer_deadline - timer_ticks < park_period);
             }
-        };
 
-        struct CPU
-        {
+            // one cycle of a parked core, counted as if the loop had run
+            auto parked_cycle() -> void
+            {
+                total_cpu_cycles++;
+                ++timer_ticks;
+                park_phase = (park_phase + 1) % park_period;
+            }
 
-            CPU(BUS *extern_bus = nullptr) : bus(extern_bus)
+            /**
+             * @brief Cycles the core can stay parked without reaching a boundary where it would resume
+             */
+            auto parked_cycles_available() const -> uint64_t
             {
-                id = id_counter++;
-                bus = extern_bus;
-                decrement(stack_pointer);
-                decrement(timer);
+                if (!is_parked() || park_wake.load(std::memory_order_acquire) || cache_written.load(std::memory_order_acquire))
+                    return 0;
 
-                if (id == 0)
-                    flag.reset(FlagIndex::OVERFLOW);
-                else
-                    flag.set(FlagIndex::HALT);
+                if (timer_deadline == no_timer_deadline)
+                    return std::numeric_limits<uint64_t>::max();
+
+                // boundaries come every park_period cycles, the first one where the deadline is in reach ends the park
+                const uint64_t to_boundary = (park_period - park_phase) % park_period;
+                const uint64_t remaining = timer_deadline - timer_ticks;
+                if (remaining < park_period + to_boundary)
+                    return to_boundary;
+
+                return to_boundary + ((remaining - to_boundary - park_period) / park_period + 1) * park_period;
             }
 
-            auto set_bus(BUS *extern_bus) -> void
+            auto skip_parked_cycles(uint64_t cycles) -> void
             {
-                this->bus = extern_bus;
+                total_cpu_cycles += static_cast<long long>(cycles);
+                timer_ticks += cycles;
+                park_phase = (park_phase + cycles) % park_period;
             }
 
-            // bitset<word_size> increment
-            template <size_t bitset_size>
-            auto increment(std::bitset<bitset_size> &value) -> void
+            // a register the counted loop adds a loop-invariant step to on every iteration
+            struct LoopInduction
             {
-                if (is_bitset_ones(value)) [[unlikely]]
+                size_t reg = 0;
+                int64_t start = 0;
+                int64_t step = 0;
+
+                auto at(int64_t iteration) const -> int64_t
                 {
-                    value.reset();
-                    flag.set(FlagIndex::OVERFLOW);
-                    return;
+                    return start + iteration * step;
                 }
+            };
 
-                for (size_t i = 0; i < bitset_size; i++)
+            static constexpr size_t max_accelerated_body = 16;
+
+            // loop values stay this far inside the signed range, so no ADD wraps and each carry follows from the signs
+            static constexpr int64_t loop_value_limit = int64_t(1) << (std::min<size_t>(word_size, 64) - 2);
+
+            auto to_loop_value(const std::bitset<word_size> &value, int64_t &out) const -> bool
+            {
+                int64_t signed_value = 0;
+
+                if constexpr (word_size < 64)
                 {
-                    if (value[i] == 0)
+                    const auto raw = static_cast<int64_t>(value.to_ullong());
+                    signed_value = value[word_size - 1] ? raw - (int64_t(1) << word_size) : raw;
+                }
+                else
+                {
+                    if constexpr (word_size > 64)
                     {
-                        value.set(i);
-                        break;
+                        // the bits above 63 must all repeat the sign
+                        const auto high = value >> 63;
+                        if (high.any() && high != (~std::bitset<word_size>() >> 63))
+                            return false;
                     }
 
-                    value.reset(i);
+                    signed_value = static_cast<int64_t>(((value << (word_size - 64)) >> (word_size - 64)).to_ullong());
+                }
+
+                if (signed_value <= -loop_value_limit || signed_value >= loop_value_limit)
+                    return false;
+
+                out = signed_value;
+                return true;
+            }
+
+            static auto from_loop_value(int64_t value) -> std::bitset<word_size>
+            {
+                std::bitset<word_size> result(static_cast<uint64_t>(value));
+                if constexpr (word_size > 64)
+                {
+                    if (value < 0)
+                        result |= ~std::bitset<word_size>() << 64;
                 }
+
+                return result;
             }
 
-            // bitset<word_size> decrement
-            template <size_t bitset_size>
-            auto decrement(std::bitset<bitset_size> &value) -> void
+            // GRT compares unsigned, a negative value is above every non-negative one
+            static auto loop_less_than(int64_t a, int64_t b) -> bool
             {
-                if (is_bitset_zero(value)) [[unlikely]]
+                return (a < 0) == (b < 0) ? a < b : b < 0;
+            }
+
+            /**
+             * @brief First iteration in [1, last] where GRT Ra Rb stops the loop, last + 1 when it runs through
+             *
+             * @note the operands change sign at most once each, between those points the unsigned compare is either
+             *       constant or the signed difference, which is linear in the iteration
+             */
+            static auto first_loop_exit(const LoopInduction &a, const LoopInduction &b, int64_t last) -> int64_t
+            {
+                std::array<int64_t, 3> bounds{1, last + 1, last + 1};
+                for (size_t i = 0; i < 2; ++i)
                 {
-                    value = ~value;
-                    flag.set(FlagIndex::OVERFLOW);
-                    return;
+                    const auto &value = i == 0 ? a : b;
+                    int64_t change = last + 1;
+                    if (value.step > 0 && value.start < 0)
+                        change = (-value.start + value.step - 1) / value.step;
+                    else if (value.step < 0 && value.start >= 0)
+                        change = value.start / -value.step + 1;
+
+                    bounds[i + 1] = std::clamp<int64_t>(change, 1, last + 1);
                 }
-                for (size_t i = 0; i < bitset_size; i++)
+                std::sort(bounds.begin(), bounds.end());
+
+                const int64_t difference = b.start - a.start;
+                const int64_t slope = b.step - a.step;
+                for (size_t i = 0; i < bounds.size(); ++i)
                 {
-                    if (value[i] == 0)
-                    {
-                        value.set(i);
-                    }
-                    else
-                    {
-                        value.reset(i);
-                        break;
+                    const int64_t first = bounds[i];
+                    const int64_t end = i + 1 < bounds.size() ? bounds[i + 1] : last + 1;
+                    if (first >= end)
+                        continue;
+
+                    if (!loop_less_than(a.at(first), b.at(first)))
+                        return first;
+
+                    // same signs: runs while difference + i * slope > 0
+                    if ((a.at(first) < 0) == (b.at(first) < 0) && slope < 0)
+                    {
+                        const int64_t exit = std::max(first, (difference - slope - 1) / -slope);
+                        if (exit < end)
+                            return exit;
                     }
                 }
+
+                return last + 1;
             }
 
-            // execute instruction
-            auto execute_instruction(bool step_mode = 0) -> void
+            /**
+             * @brief Skips the iterations of a counted register loop that branch back, in closed form
+             *
+             * @note the body from the back-edge target down to branch may only hold ADDs of loop-invariant steps to
+             *       distinct registers, and end in GRT + BIN (runs while Ra < Rb) or BIZ + BUN (leaves on ZERO). The
+             *       iteration that leaves is always stepped, so the exit itself runs exactly as before
+             */
+            auto fast_forward_counted_loop(size_t branch) -> void
             {
-                if (!this->bus)
-                {
-                    std::cerr << "Bus not connected" << std::endl;
+                const size_t head = stack_pointer.to_ulong();
+                if (interrupt_enabled || head <= branch || head - branch + 1 > max_accelerated_body)
                     return;
-                }
 
-                if (id == 0 && !initialized) [[unlikely]]
+                const size_t body = head - branch + 1;
+                if (body < 3)
+                    return;
+
+                // a skipped stretch would move the completion interrupt to a later iteration
+                if (bus && (bus->dma_interrupt_targets.load(std::memory_order_acquire) & dma_interrupt_mask(id + 1)))
+                    return;
+
+                Instruction instructions[max_accelerated_body];
+                for (size_t i = 0; i < body; ++i)
+                    instructions[i] = decoded_slot(head - i).instruction;
+
+                const auto &test = instructions[body - 2];
+                const auto &jump = instructions[body - 1];
+                const bool runs_while_less = test.opcode == &CPU::GRT && jump.opcode == &CPU::BIN;
+                const bool leaves_on_zero = test.opcode == &CPU::BIZ && jump.opcode == &CPU::BUN;
+                if (!runs_while_less && !leaves_on_zero)
+                    return;
+
+                // R8 is the hidden temp register, loops only count in R0-R7
+                std::array<LoopInduction, max_accelerated_body> inductions;
+                const size_t induction_count = body - 2;
+                uint32_t written = 0;
+                for (size_t i = 0; i < induction_count; ++i)
                 {
-                    if (flag[FlagIndex::OVERFLOW] == 1) [[unlikely]]
-                    {
-                        flag.reset(FlagIndex::OVERFLOW);
-                        initialized = true;
-                        goto emerg_break;
-                    }
+                    const auto &add = instructions[i];
+                    if (add.opcode != &CPU::ADD || add.dest >= 8 || add.src_1 >= 8 || add.src_2 >= 8 || (written >> add.dest) & 1U)
+                        return;
+                    if ((add.src_1 == add.dest) == (add.src_2 == add.dest))
+                        return;
 
-                    total_cpu_cycles++;
+                    written |= 1U << add.dest;
+                    inductions[i].reg = add.dest;
+                }
 
-                    cache[stack_pointer.to_ulong()] = bus->read(true, id, 0, stack_pointer.to_ulong());
+                for (size_t i = 0; i < induction_count; ++i)
+                {
+                    const auto &add = instructions[i];
+                    const size_t step_reg = add.src_1 == add.dest ? add.src_2 : add.src_1;
+                    if ((written >> step_reg) & 1U || !to_loop_value(reg[add.dest], inductions[i].start) ||
+                        !to_loop_value(reg[step_reg], inductions[i].step))
+                        return;
+                }
 
-                    decrement(stack_pointer);
-                    decrement(timer);
+                if (test.src_1 >= 8 || test.src_2 >= 8 || test.dest >= 8 || jump.dest >= 8 || (written >> jump.dest) & 1U ||
+                    (leaves_on_zero && (written >> test.dest) & 1U))
                     return;
+
+                // the last iteration every value stays in range for, also bounded by the cycle counter and the timer,
+                // whose tick for the current cycle is still to come and must be the only one to reach the deadline
+                const auto cycles_per_iteration = static_cast<int64_t>(body * 2);
+                int64_t last = std::numeric_limits<int64_t>::max() / 4 / cycles_per_iteration;
+                if (timer_deadline != no_timer_deadline)
+                {
+                    if (timer_deadline <= timer_ticks)
+                        return;
+
+                    const uint64_t ticks_left = (timer_deadline - timer_ticks - 1) / static_cast<uint64_t>(cycles_per_iteration);
+                    last = static_cast<int64_t>(std::min<uint64_t>(static_cast<uint64_t>(last), ticks_left));
                 }
-                else
+
+                for (size_t i = 0; i < induction_count; ++i)
                 {
-                emerg_break:
+                    const auto &value = inductions[i];
+                    if (value.step > 0)
+                        last = std::min(last, (loop_value_limit - 1 - value.start) / value.step);
+                    else if (value.step < 0)
+                        last = std::min(last, (value.start + loop_value_limit - 1) / -value.step);
+                }
 
-                    if ((flag & std::bitset<8>(0).set(FlagIndex::HALT)).to_ulong() > 0)
+                // the first iteration that does not branch back
+                int64_t exit = last + 1;
+                if (runs_while_less)
+                {
+                    LoopInduction compared[2];
+                    const size_t operands[2] = {test.src_1, test.src_2};
+                    for (size_t side = 0; side < 2; ++side)
                     {
-                        debug_print(std::string("CPU ").append(std::to_string(id)), " halted");
-                        return;
+                        compared[side].reg = operands[side];
+                        const auto found = std::find_if(inductions.begin(), inductions.begin() + induction_count, [&](const LoopInduction &value)
+                                                        { return value.reg == operands[side]; });
+                        if (found != inductions.begin() + induction_count)
+                            compared[side] = *found;
+                        else if (!to_loop_value(reg[operands[side]], compared[side].start))
+                            return;
                     }
 
-                    if (interrupt_enabled && new_instruction) [[unlikely]]
+                    exit = first_loop_exit(compared[0], compared[1], last);
+                }
+                else if (flag[FlagIndex::ZERO])
+                {
+                    exit = 1;
+                }
+                else
+                {
+                    for (size_t i = 0; i < induction_count; ++i)
                     {
-                        interrupt_enabled = false;
-                        flag.reset(FlagIndex::INTERRUPT);
-                        stack_pointer = interrupt_seg_index;
+                        const auto &value = inductions[i];
+                        if (value.step == 0 && value.start == 0)
+                            exit = 1;
+                        else if (value.step != 0 && value.start % value.step == 0 && -value.start / value.step >= 1)
+                            exit = std::min(exit, -value.start / value.step);
                     }
+                }
 
-                    if (new_instruction)
-                        new_instruction = false;
-
-                    if (step_mode)
-                    {
-                        switch (instruction_cycle)
-                        {
-                        case 0:
+                const int64_t skipped = std::min(exit - 1, last);
+                if (skipped <= 0)
+                    return;
 
-                            if (timer == 0) [[unlikely]]
-                            {
-                                interrupt_enabled = true;
-                                flag.set(FlagIndex::INTERRUPT);
-                            }
+                // ADD flags are sticky, each one only needs to know whether iterations 1..skipped ever raised it
+                for (size_t i = 0; i < induction_count; ++i)
+                {
+                    const auto &value = inductions[i];
+                    const int64_t first = value.at(1);
+                    const int64_t final = value.at(skipped);
 
-                            instruction_cycle = 1;
-                            total_cpu_cycles++;
+                    bool zero = false;
+                    bool carry = false;
+                    if (value.step == 0)
+                    {
+                        zero = value.start == 0;
+                    }
+                    else
+                    {
+                        zero = value.start % value.step == 0 && -value.start / value.step >= 1 && -value.start / value.step <= skipped;
 
-                            // fetch instruction
-                            current_word = cache[stack_pointer.to_ulong()];
-                            acc = to_xbits<32>(current_word);
-                            current_instruction = decode_instruction(acc);
+                        // adding a negative step carries on every iteration but the one crossing below zero
+                        if (value.step > 0)
+                            carry = value.start < 0 && final >= 0;
+                        else
+                            carry = skipped > 1 || value.start < 0 || first >= 0;
+                    }
 
-                            decrement(timer);
-                            break;
+                    if (zero)
+                        flag.set(FlagIndex::ZERO);
+                    if (std::min(first, final) < 0)
+                        flag.set(FlagIndex::SIGN);
+                    if (carry)
+                        flag.set(FlagIndex::OVERFLOW);
 
-                        case 1:
+                    reg[value.reg] = from_loop_value(final);
+                }
 
-                            if (timer == 0) [[unlikely]]
-                            {
-                                interrupt_enabled = true;
-                                flag.set(FlagIndex::INTERRUPT);
-                            }
+                // every skipped GRT found Ra < Rb
+                if (runs_while_less)
+                    flag.set(FlagIndex::SIGN);
 
-                            instruction_cycle = 0;
-                            total_cpu_cycles++;
+                const int64_t cycles = skipped * cycles_per_iteration;
+                total_cpu_cycles += cycles;
+                timer_ticks += static_cast<uint64_t>(cycles);
+            }
 
-                            // execute instruction
-                            (this->*current_instruction.opcode)();
+            /**
+             * @brief Loads the timer, which then counts down by one per cycle
+             *
+             * @note the timer is kept as the loaded value plus the ticks since, so a cycle only compares two integers.
+             *       Values that need more than 64 bits never reach zero within a run and get no deadline
+             */
+            auto load_timer(const std::bitset<word_size> &value) -> void
+            {
+                bool fits = true;
+                if constexpr (word_size > 64)
+                    fits = (value >> 64).none();
 
-                            new_instruction = true;
+                timer_base = value;
+                timer_ticks = 0;
+                timer_deadline = fits ? value.to_ullong() : no_timer_deadline;
+            }
 
-                            decrement(stack_pointer);
-                            decrement(timer);
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        if (timer == 0) [[unlikely]]
-                        {
-                            interrupt_enabled = true;
-                            flag.set(FlagIndex::INTERRUPT);
-                        }
+            auto timer_expired() const -> bool
+            {
+                return timer_ticks == timer_deadline;
+            }
 
-                        instruction_cycle = 1;
-                        total_cpu_cycles++;
+            /**
+             * @brief Counts one cycle down, wrapping from zero to all ones sets OVERFLOW like decrement
+             */
+            auto tick_timer() -> void
+            {
+                if (timer_expired()) [[unlikely]]
+                {
+                    load_timer(~std::bitset<word_size>());
+                    flag.set(FlagIndex::OVERFLOW);
+                    return;
+                }
 
-                        // fetch instruction
-                        current_word = cache[stack_pointer.to_ulong()];
-                        acc = to_xbits<32>(current_word);
-                        current_instruction = decode_instruction(acc);
+                ++timer_ticks;
+            }
 
-                        total_cpu_cycles++;
-                        decrement(stack_pointer);
-                        decrement(timer);
+            /**
+             * @brief The current timer register, computed from the loaded value and the elapsed ticks
+             */
+            auto timer_value() -> std::bitset<word_size>
+            {
+                std::bitset<word_size> base = timer_base;
+                std::bitset<word_size> negated_ticks = ~std::bitset<word_size>(timer_ticks);
+                std::bitset<word_size> one(1);
 
-                        for (size_t i = 1; i < to_size_t(current_instruction.cycles); i++)
-                        {
-                            execute_instruction(true);
-                        }
-                    }
-                }
+                auto difference = add_bitset(base, negated_ticks).first;
+                return add_bitset(difference, one).first;
             }
 
             /**
@@ -1348,6 +4829,9 @@ namespace FIAT128
             template <size_t target_size>
             auto to_xbits(std::bitset<word_size> &word) -> std::bitset<target_size>
             {
+                if constexpr (fits_native_word<word_size>)
+                    return std::bitset<target_size>(word.to_ullong() >> (word_size - target_size));
+
                 std::bitset<target_size> result;
 
                 for (size_t i = 0; i < target_size; ++i)
@@ -1387,8 +4871,9 @@ namespace FIAT128
                     return false;
                 }
 
-                cache[index] = std::bitset<word_size>(u32(instruction) << 24 | u32(operand_1) << 16 | u32(operand_2) << 8 | u32(operand_3));
-                cache[index] <<= (word_size - 32);
+                cache[static_cast<size_t>(index)] = std::bitset<word_size>(u32(instruction) << 24 | u32(operand_1) << 16 | u32(operand_2) << 8 | u32(operand_3));
+                cache[static_cast<size_t>(index)] <<= (word_size - 32);
+                note_cache_write();
 
                 return true;
             }
@@ -1402,8 +4887,9 @@ namespace FIAT128
                 }
 
                 const auto packed_operand = static_cast<unsigned char>((to_uchar(operand_1) << 4) | (module & 0x0F));
-                cache[index] = std::bitset<word_size>(u32(instruction) << 24 | u32(packed_operand) << 16 | u32(address));
-                cache[index] <<= (word_size - 32);
+                cache[static_cast<size_t>(index)] = std::bitset<word_size>(u32(instruction) << 24 | u32(packed_operand) << 16 | u32(address));
+                cache[static_cast<size_t>(index)] <<= (word_size - 32);
+                note_cache_write();
 
                 return true;
             }
@@ -1418,7 +4904,8 @@ namespace FIAT128
                     return false;
                 }
 
-                cache[index] = word;
+                cache[static_cast<size_t>(index)] = word;
+                note_cache_write();
 
                 return true;
             }
@@ -1429,8 +4916,8 @@ namespace FIAT128
                 std::cout << "ID: " << id << std::endl;
                 std::cout << "SP: " << stack_pointer << std::endl;
                 std::cout << "II: " << interrupt_seg_index << std::endl;
-                std::cout << "TI: " << timer << std::endl;
-                std::cout << "FL: " << flag << std::endl;
+                std::cout << "TI: " << timer_value() << std::endl;
+                std::cout << "FL: " << current_flags() << std::endl;
 
                 for (int i = 0; i < 8; i++)
                 {
@@ -1503,12 +4990,6 @@ namespace FIAT128
                 }
             }
 
-            // cpu cache
-            std::bitset<word_size> cache[cache_size];
-
-            // 128-bit general purpose registers [R0-R7, 6 & 7 are vector registers, 8 is a non-programable temp register]
-            std::bitset<word_size> reg[9];
-
             // the flag register [0 interrupt flag, 1 overflow flag, 2 zero flag, 3 sign flag, 4 hlt flag]
             enum FlagIndex
             {
@@ -1518,13 +4999,11 @@ namespace FIAT128
                 SIGN = u32(3),
                 HALT = u32(4),
             };
-            std::bitset<8> flag;
 
-            // Timer register, counts till the end of time!
-            std::bitset<word_size> timer;
+            // Timer register, counts till the end of time! Read it through timer_value()
+            std::bitset<word_size> timer_base;
 
-            // Stack pointer [to index the cache]
-            std::bitset<u32(std::log2(cache_size))> stack_pointer;
+            static constexpr uint64_t no_timer_deadline = std::numeric_limits<uint64_t>::max();
 
             // Segment index (interrupt)
             std::bitset<u32(std::log2(cache_size))> interrupt_seg_index;
@@ -1535,18 +5014,88 @@ namespace FIAT128
             // Accumulator - temp register, not visible to the user
             std::bitset<32> acc;
 
-            // Interrupt enable flag
-            bool interrupt_enabled = false;
-            bool initialized = false;
+            // busy-wait parking, the state at the last back-edge and what the iteration since then did
+            struct SpinRead
+            {
+                size_t module = 0;
+                size_t address = 0;
+                std::bitset<word_size> value;
+                uint64_t offset = 0; // cycles into the iteration when the read ran
+            };
 
-            size_t id = 0;
-            BUS *bus = nullptr;
+            // the spin reads of a parked core as seen by writer threads, published by the release store to parked
+            struct ParkedRead
+            {
+                std::atomic<size_t> module{0};
+                std::atomic<size_t> address{0};
+                std::atomic<uint64_t> offset{0};
+            };
+
+            static constexpr size_t max_spin_reads = 4;
+            static constexpr size_t no_spin_branch = std::numeric_limits<size_t>::max();
+
+            size_t spin_branch = no_spin_branch;
+            long long spin_cycle = 0;
+            std::bitset<word_size> spin_reg[9];
+            std::bitset<8> spin_flag;
+            std::bitset<u32(std::log2(cache_size))> spin_stack_pointer;
+            std::array<SpinRead, max_spin_reads> spin_reads{};
+            size_t spin_read_count = 0;
+            bool spin_pure = false;
+            // parking of polling loops, see set_core_parking
+            bool park_spinning = false;
+
+            // a parked core counts cycles through its loop without running it, park_phase cycles past the boundary
+            uint64_t park_period = 0;
+            uint64_t park_phase = 0;
+            std::atomic<bool> park_wake{false};
+            // earliest iteration cycle that reads a word written since the park, 0 resumes at the next boundary
+            std::atomic<uint64_t> park_wake_offset{0};
+            static constexpr uint64_t no_wake_offset = std::numeric_limits<uint64_t>::max();
+            std::array<ParkedRead, max_spin_reads> parked_reads{};
+            std::atomic<size_t> parked_read_count{0};
+
+            // set by every cache write from outside the core, the loop code may have changed under a spin
+            std::atomic<bool> cache_written{false};
+            // bumped by the same writes, decoded slots of an older generation are decoded again
+            std::atomic<uint64_t> code_generation{1};
+
+            auto note_cache_write() -> void
+            {
+                code_generation.fetch_add(1, std::memory_order_release);
+                cache_written.store(true, std::memory_order_release);
+            }
+
+            /**
+             * @brief Drops the decoded slots a write by the core itself to cache[index] makes stale
+             *
+             * @note the slot above decodes cache[index] as its fusion partner
+             */
+            auto forget_decoded(size_t index) -> void
+            {
+                if (index < cache_size)
+                    decoded_cache[index].generation = 0;
+                if (index + 1 < cache_size)
+                    decoded_cache[index + 1].generation = 0;
+            }
 
             /* instruction function definitions */
 
             template <size_t input_size>
             auto add_bitset(std::bitset<input_size> &a, std::bitset<input_size> &b) -> std::pair<std::bitset<input_size>, bool>
             {
+                if constexpr (fits_native_word<input_size>)
+                {
+                    const uint64_t lhs = a.to_ullong();
+                    const uint64_t sum = lhs + b.to_ullong();
+
+                    // narrower words keep their carry in the bit above the word, 64-bit ones wrap
+                    if constexpr (input_size == 64)
+                        return {std::bitset<input_size>(sum), sum < lhs};
+                    else
+                        return {std::bitset<input_size>(sum), ((sum >> input_size) & 1U) != 0};
+                }
+
                 std::bitset<input_size> result;
                 bool overflow = false;
 
@@ -1559,6 +5108,39 @@ namespace FIAT128
                 return {result, overflow};
             }
 
+            /**
+             * @brief Records the ZERO and SIGN an ALU result sets, they reach flag once a branch or GRT needs them
+             *
+             * @note the flags are sticky, so results only ever add pending bits and a run of ALU ops never touches flag
+             */
+            auto defer_flags(const std::bitset<word_size> &result) -> void
+            {
+                if (pending_flags == pending_zero_sign)
+                    return;
+
+                if (result.none())
+                    pending_flags |= uint8_t(1) << FlagIndex::ZERO;
+                if (result[word_size - 1])
+                    pending_flags |= uint8_t(1) << FlagIndex::SIGN;
+            }
+
+            auto fold_flags() -> void
+            {
+                if (pending_flags == 0)
+                    return;
+
+                flag |= std::bitset<8>(pending_flags);
+                pending_flags = 0;
+            }
+
+            /**
+             * @brief The flag register with the pending ALU flags applied, without folding them
+             */
+            auto current_flags() const -> std::bitset<8>
+            {
+                return flag | std::bitset<8>(pending_flags);
+            }
+
             template <size_t input_size>
             auto is_bitset_positive(std::bitset<input_size> &a) -> bool
             {
@@ -1568,6 +5150,9 @@ namespace FIAT128
             template <size_t input_size>
             auto is_bitset_zero(std::bitset<input_size> &a) -> bool
             {
+                if constexpr (fits_native_word<input_size>)
+                    return a.to_ullong() == 0;
+
                 for (size_t i = 0; i < input_size; i++)
                 {
                     if (a[i] == 1)
@@ -1582,6 +5167,9 @@ namespace FIAT128
             template <size_t input_size>
             auto is_bitset_ones(std::bitset<input_size> &a) -> bool
             {
+                if constexpr (fits_native_word<input_size>)
+                    return a.all();
+
                 for (size_t i = 0; i < input_size; i++)
                 {
                     if (a[i] != 1)
@@ -1605,11 +5193,7 @@ namespace FIAT128
                 if (result.second)
                     flag.set(FlagIndex::OVERFLOW);
 
-                if (is_bitset_zero(result.first))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(result.first))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(result.first);
 
                 reg[current_instruction.dest] = result.first;
 
@@ -1625,10 +5209,7 @@ namespace FIAT128
             {
                 reg[current_instruction.dest] = reg[current_instruction.src_1] & reg[current_instruction.src_2];
 
-                if (is_bitset_zero(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::ZERO);
-                if (!is_bitset_positive(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.dest]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " AND executed");
             }
@@ -1642,11 +5223,7 @@ namespace FIAT128
             {
                 reg[current_instruction.dest] = reg[current_instruction.src_1] | reg[current_instruction.src_2];
 
-                if (is_bitset_zero(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.dest]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " OR executed");
             }
@@ -1660,11 +5237,7 @@ namespace FIAT128
             {
                 reg[current_instruction.dest] = reg[current_instruction.src_1] ^ reg[current_instruction.src_2];
 
-                if (is_bitset_zero(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.dest]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " XOR executed");
             }
@@ -1678,11 +5251,7 @@ namespace FIAT128
             {
                 reg[current_instruction.dest] = reg[current_instruction.src_1];
 
-                if (is_bitset_zero(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.dest]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " MOV executed");
             }
@@ -1702,6 +5271,7 @@ namespace FIAT128
              */
             void BIZ()
             {
+                fold_flags();
                 if ((flag & std::bitset<8>(0).set(2)).to_ulong() > 0)
                     stack_pointer = reg[current_instruction.dest].to_ulong();
 
@@ -1713,6 +5283,7 @@ namespace FIAT128
              */
             void BIN()
             {
+                fold_flags();
                 if ((flag & std::bitset<8>(0).set(FlagIndex::SIGN)).to_ulong() > 0)
                     stack_pointer = reg[current_instruction.dest].to_ulong();
 
@@ -1727,11 +5298,10 @@ namespace FIAT128
             void LDA()
             {
                 reg[current_instruction.dest] = bus->read(true, id, current_instruction.module, current_instruction.address);
+                if (park_spinning) [[unlikely]]
+                    note_spin_read(current_instruction.module, current_instruction.address, reg[current_instruction.dest]);
 
-                if (is_bitset_zero(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::ZERO);
-                if (!is_bitset_positive(reg[current_instruction.dest]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.dest]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " LDA executed");
             }
@@ -1742,6 +5312,7 @@ namespace FIAT128
             void STA()
             {
                 bus->write(true, id, current_instruction.module, current_instruction.address, reg[current_instruction.dest]);
+                spin_pure = false;
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " STA executed");
             }
@@ -1763,7 +5334,10 @@ namespace FIAT128
              */
             void STR()
             {
-                cache[reg[current_instruction.dest].to_ulong()] = reg[current_instruction.src_1];
+                const size_t index = reg[current_instruction.dest].to_ulong();
+                cache[index] = reg[current_instruction.src_1];
+                forget_decoded(index);
+                spin_pure = false;
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " STR executed");
             }
@@ -1786,15 +5360,24 @@ namespace FIAT128
             {
                 bool less_than = false;
 
-                for (size_t i = word_size; i-- > 0;)
+                if constexpr (fits_native_word<word_size>)
+                {
+                    less_than = reg[current_instruction.src_1].to_ullong() < reg[current_instruction.src_2].to_ullong();
+                }
+                else
                 {
-                    if (reg[current_instruction.src_1][i] != reg[current_instruction.src_2][i])
+                    for (size_t i = word_size; i-- > 0;)
                     {
-                        less_than = reg[current_instruction.src_1][i] < reg[current_instruction.src_2][i];
-                        break;
+                        if (reg[current_instruction.src_1][i] != reg[current_instruction.src_2][i])
+                        {
+                            less_than = reg[current_instruction.src_1][i] < reg[current_instruction.src_2][i];
+                            break;
+                        }
                     }
                 }
 
+                // a pending result must not set SIGN after the compare decided it
+                fold_flags();
                 if (less_than)
                     flag.set(FlagIndex::SIGN);
                 else
@@ -1812,10 +5395,7 @@ namespace FIAT128
             {
                 reg[current_instruction.src_1] <<= 1;
 
-                if (is_bitset_zero(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::ZERO);
-                if (!is_bitset_positive(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.src_1]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " SHL executed");
             }
@@ -1829,10 +5409,7 @@ namespace FIAT128
             {
                 reg[current_instruction.src_1] >>= 1;
 
-                if (is_bitset_zero(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::ZERO);
-                if (!is_bitset_positive(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.src_1]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " SHR executed");
             }
@@ -1846,11 +5423,7 @@ namespace FIAT128
             {
                 reg[current_instruction.src_1] <<= 1;
 
-                if (is_bitset_zero(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.src_1]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " ROL executed");
             }
@@ -1864,11 +5437,7 @@ namespace FIAT128
             {
                 reg[current_instruction.src_1] >>= 1;
 
-                if (is_bitset_zero(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::ZERO);
-
-                if (!is_bitset_positive(reg[current_instruction.src_1]))
-                    flag.set(FlagIndex::SIGN);
+                defer_flags(reg[current_instruction.src_1]);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " ROR executed");
             }
@@ -1878,19 +5447,66 @@ namespace FIAT128
              */
             void INT()
             {
+                spin_pure = false;
+                auto &rom = *bus->memory[0];
 
-                for (size_t i = 1; i <= cores; i++)
+                // a device or read watchpoint on the ROM channel has to see the reads, so it keeps the BUS path
+                if (bus->reads_are_observed(0)) [[unlikely]]
+                {
+                    for (size_t i = 1; i <= cores; i++)
+                    {
+                        const auto segment = bus->read_range(id, 0, cache_size * i, cache_size);
+                        std::lock_guard<std::mutex> lock(bus->cpu_mutex);
+                        std::copy(segment.begin(), segment.end(), bus->cpus[i]->cache.begin());
+                        std::fill(bus->cpus[i]->cache.begin() + static_cast<std::ptrdiff_t>(segment.size()), bus->cpus[i]->cache.end(), std::bitset<word_size>(0));
+                        bus->cpus[i]->note_cache_write();
+                    }
+                }
+                else
                 {
-                    for (size_t j = 0; j < cache_size; j++)
+                    std::scoped_lock lock(rom.memory_mutex, bus->cpu_mutex);
+
+                    auto load_cache = [&](size_t core)
+                    {
+                        const size_t first = cache_size * core;
+                        const size_t count = first < rom.size() ? std::min<size_t>(cache_size, rom.size() - first) : 0;
+                        rom.load_range(first, count, bus->cpus[core]->cache.data());
+                        std::fill(bus->cpus[core]->cache.begin() + static_cast<std::ptrdiff_t>(count), bus->cpus[core]->cache.end(), std::bitset<word_size>(0));
+                        bus->cpus[core]->note_cache_write();
+                    };
+
+                    // a thread only pays for itself on a large copy, typical core counts load inline
+                    constexpr size_t boot_bytes = cores * cache_size * sizeof(std::bitset<word_size>);
+                    const size_t workers = std::min<size_t>({cores, std::max(1U, std::thread::hardware_concurrency()), boot_bytes / parallel_boot_bytes});
+                    if (workers > 1)
+                    {
+                        std::vector<std::thread> threads;
+                        threads.reserve(workers);
+                        for (size_t worker = 0; worker < workers; worker++)
+                        {
+                            threads.emplace_back([&, worker]()
+                                                 {
+                                                     for (size_t i = 1 + worker; i <= cores; i += workers)
+                                                         load_cache(i);
+                                                 });
+                        }
+
+                        for (auto &thread : threads)
+                            thread.join();
+                    }
+                    else
                     {
-                        auto read_value = bus->read(true, id, 0, cache_size * i + j);
-                        bus->write(false, i, 0, j, read_value);
+                        for (size_t i = 1; i <= cores; i++)
+                            load_cache(i);
                     }
+                }
 
+                for (size_t i = 1; i <= cores; i++)
+                {
                     bus->cpus[i]->initialized = true;
                     bus->cpus[i]->new_instruction = true;
                     bus->cpus[i]->instruction_cycle = 0;
-                    bus->cpus[i]->flag.reset(FlagIndex::HALT);
+                    bus->cpus[i]->set_halted(false);
                 }
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " INT executed");
@@ -1901,7 +5517,8 @@ namespace FIAT128
              */
             void HLT()
             {
-                flag |= 0b0001'0000;
+                spin_pure = false;
+                set_halted(true);
 
                 debug_print(std::string("CPU ").append(std::to_string(id)), " HLT executed");
             }
@@ -1921,6 +5538,9 @@ namespace FIAT128
             // instruction count
             static const unsigned char instruction_count = 21;
 
+            // INT splits the cache loads across worker threads once each worker gets at least this many bytes
+            static constexpr size_t parallel_boot_bytes = size_t(4) << 20;
+
             // instrcution table
             static inline Instruction instruction_table[instruction_count] = {
                 {"XXX", &CPU::XXX, 2, 0, 0, 0, InstructionAccess::Internal},
@@ -1946,15 +5566,138 @@ namespace FIAT128
                 {"HLT", &CPU::HLT, 2, 0, 0, 0, InstructionAccess::Control},
             };
 
+            /**
+             * @brief Cycles one run() call covers outside step mode, 0 when the instructions differ in length
+             *
+             * @note a parked core replays whole iterations, so it only counts run() calls in cycles when they all match
+             */
+            static auto cycles_per_instruction() -> size_t
+            {
+                const size_t cycles = instruction_table[0].cycles;
+                for (const auto &instruction : instruction_table)
+                {
+                    if (instruction.cycles != cycles)
+                        return 0;
+                }
+
+                return cycles;
+            }
+
+            // pairs whose second half runs in the dispatch of the first, see run_fused_partner
+            enum class FusedPair : unsigned char
+            {
+                None,
+                CompareBranchZero, // EQL, BIZ
+                CompareBranchSign, // GRT, BIN
+                AddBranchZero,     // ADD, BIZ
+                AddBranchSign,     // ADD, BIN
+                MemoryMove,        // LDA, STA of the same register
+            };
+
+            struct DecodedSlot
+            {
+                std::bitset<32> encoded;
+                Instruction instruction;
+                // the instruction below, which runs next unless this one branches
+                std::bitset<32> partner_encoded;
+                Instruction partner;
+                FusedPair fused = FusedPair::None;
+                // code_generation the slot was decoded at, 0 until the first decode
+                uint64_t generation = 0;
+            };
+
+            /* hot state, read or written on every cycle. It starts on a cache line of its own, the control fields
+               fill the first two lines and the registers follow, the cold state comes after or lives on the heap */
+
             // current instruction
-            Instruction current_instruction;
-            std::bitset<word_size> current_word;
+            alignas(64) Instruction current_instruction;
 
-            // cpu cycles
+            // cpu cycles and timer ticks since the last load_timer()
             long long total_cpu_cycles = 0;
-            char instruction_cycle = 0;
+            uint64_t timer_ticks = 0;
+            uint64_t timer_deadline = no_timer_deadline;
+
+            BUS *bus = nullptr;
+            size_t id = 0;
+
+            std::bitset<8> flag;
+
+            // Stack pointer [to index the cache]
+            std::bitset<u32(std::log2(cache_size))> stack_pointer;
 
+            char instruction_cycle = 0;
             bool new_instruction = true;
+
+            // Interrupt enable flag
+            bool interrupt_enabled = false;
+            bool initialized = false;
+            // written by the core only, read by writer threads when they wake parked cores
+            std::atomic<bool> parked{false};
+
+            // ZERO and SIGN set by ALU results since the last read of flag, in flag's bit positions, see defer_flags
+            uint8_t pending_flags = 0;
+            static constexpr uint8_t pending_zero_sign = (uint8_t(1) << FlagIndex::ZERO) | (uint8_t(1) << FlagIndex::SIGN);
+
+            // closed-form skipping of counted loops, see fast_forward_counted_loop
+            bool accelerate_loops = false;
+            // fused dispatch of instruction pairs outside step mode, see run_fused_partner
+            bool fuse_instructions = false;
+
+            // 128-bit general purpose registers [R0-R7, 6 & 7 are vector registers, 8 is a non-programable temp register]
+            alignas(64) std::bitset<word_size> reg[9];
+            std::bitset<word_size> current_word;
+
+            // cpu cache and one pre-decoded slot per cache word, allocated apart so the CPUs of an emulator sit close together
+            std::vector<std::bitset<word_size>, AlignedAllocator<std::bitset<word_size>>> cache =
+                std::vector<std::bitset<word_size>, AlignedAllocator<std::bitset<word_size>>>(cache_size);
+            std::vector<DecodedSlot, AlignedAllocator<DecodedSlot>> decoded_cache = std::vector<DecodedSlot, AlignedAllocator<DecodedSlot>>(cache_size);
+
+            /**
+             * @brief The pre-decoded form of cache[pc], decoded again only after a cache write
+             *
+             * @note writes from outside the core bump code_generation, the core's own writes go through forget_decoded
+             */
+            auto decoded_slot(size_t pc) -> const DecodedSlot &
+            {
+                auto &slot = decoded_cache[pc];
+                const auto generation = code_generation.load(std::memory_order_acquire);
+
+                if (slot.generation != generation) [[unlikely]]
+                {
+                    slot.encoded = to_xbits<32>(cache[pc]);
+                    slot.instruction = decode_instruction(slot.encoded);
+                    slot.fused = FusedPair::None;
+                    if (pc > 0)
+                    {
+                        slot.partner_encoded = to_xbits<32>(cache[pc - 1]);
+                        slot.partner = decode_instruction(slot.partner_encoded);
+                        slot.fused = fused_pair(slot.instruction, slot.partner);
+                    }
+                    slot.generation = generation;
+                }
+
+                return slot;
+            }
+
+            static auto fused_pair(const Instruction &first, const Instruction &second) -> FusedPair
+            {
+                // the cycles charged between the halves are those of a two-cycle instruction
+                if (first.cycles != 2 || second.cycles != 2)
+                    return FusedPair::None;
+
+                if (first.opcode == &CPU::EQL && second.opcode == &CPU::BIZ)
+                    return FusedPair::CompareBranchZero;
+                if (first.opcode == &CPU::GRT && second.opcode == &CPU::BIN)
+                    return FusedPair::CompareBranchSign;
+                if (first.opcode == &CPU::ADD && second.opcode == &CPU::BIZ)
+                    return FusedPair::AddBranchZero;
+                if (first.opcode == &CPU::ADD && second.opcode == &CPU::BIN)
+                    return FusedPair::AddBranchSign;
+                if (first.opcode == &CPU::LDA && second.opcode == &CPU::STA && first.dest == second.dest)
+                    return FusedPair::MemoryMove;
+
+                return FusedPair::None;
+            }
         };
 
         CpuIdResetter cpu_id_resetter;
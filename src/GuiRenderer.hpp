@@ -5,6 +5,7 @@
 #include "ProgramRepository.hpp"
 
 #include <algorithm>
+#include <any>
 #include <array>
 #include <cstdlib>
 #include <cctype>
@@ -15,6 +16,7 @@
 #include <stdexcept>
 #include <iomanip>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -202,6 +204,16 @@ public:
         return parse_program_file(entry->disk_path);
     }
 
+    // Follows the memory writes of emulator from now on, attach before loading a program so its writes show up.
+    template <typename EmulatorT>
+    auto attach(EmulatorT &emulator) -> void
+    {
+        // GPU RAM traffic stays out of the write log.
+        FIAT128::MemoryWriteFilter filter;
+        filter.channels = ~(1ULL << 3);
+        memory_subscription = emulator.subscribe_memory_writes(filter);
+    }
+
     template <typename EmulatorT>
     auto draw_frame(EmulatorT &emulator) -> void
     {
@@ -210,16 +222,23 @@ public:
             return;
 
         auto cpu_states = emulator.get_cpu_render_state();
-        auto new_events = emulator.get_memory_write_events_since(last_seen_memory_sequence);
+        dma_channel = emulator.get_dma_channel();
+        auto new_events = emulator.poll_memory_writes(memory_subscription);
+        if (!new_events)
+        {
+            // A different emulator is being drawn without attach(), follow it from here.
+            attach(emulator);
+            new_events = emulator.poll_memory_writes(memory_subscription);
+        }
 
-        if (!new_events.empty())
+        if (new_events && !new_events->empty())
         {
             changed_memory_positions_this_frame.clear();
-            last_seen_memory_sequence = new_events.back().sequence;
-            for (const auto &event : new_events)
+            for (const auto &event : *new_events)
             {
                 memory_lines.push_back(format_memory_line(event));
-                changed_memory_positions_this_frame.insert(memory_position_key(event.channel, event.index));
+                for (size_t offset = 0; offset < event.count; ++offset)
+                    changed_memory_positions_this_frame.insert(memory_position_key(event.channel, event.index + offset));
                 if (memory_lines.size() > 18)
                     memory_lines.pop_front();
             }
@@ -227,11 +246,8 @@ public:
 
         std::vector<std::string> mem_lines = build_memory_lines(emulator);
 
-        auto snapshot = emulator.get_memory_snapshot();
-        active_module_count = std::max<size_t>(1, snapshot.size());
-
-        if (!snapshot.empty())
-            selected_memory_module = std::min(selected_memory_module, snapshot.size() - 1);
+        active_module_count = std::max<size_t>(1, emulator.get_memory_module_count());
+        selected_memory_module = std::min(selected_memory_module, active_module_count - 1);
 
         std::vector<std::string> video_lines;
         video_lines.push_back("GPU SCREEN");
@@ -280,6 +296,8 @@ private:
              << "  " << std::setw(2) << event.channel
              << "  " << std::setw(4) << event.index
                << "  " << int128_text;
+        if (event.count > 1)
+            line << "  x" << event.count;
         return line.str();
     }
 
@@ -300,46 +318,47 @@ private:
             return mem_lines;
         }
 
-        auto snapshot = emulator.get_memory_snapshot();
         std::vector<std::string> mem_lines;
         mem_lines.push_back(number_display_mode == NumberDisplayMode::Hex ? "IDX  WORD                                                 CH" : "IDX  WORD    CH");
 
-        if (snapshot.empty())
+        if (emulator.get_memory_module_count() == 0)
         {
             mem_lines.push_back("NO MEMORY SNAPSHOT AVAILABLE");
             return mem_lines;
         }
 
-        selected_memory_module = std::min(selected_memory_module, snapshot.size() - 1);
+        selected_memory_module = std::min(selected_memory_module, emulator.get_memory_module_count() - 1);
+
+        using Mirror = typename EmulatorT::MemoryMirror;
+        auto *mirror = std::any_cast<Mirror>(&memory_mirror);
+        if (!mirror)
+            mirror = &memory_mirror.emplace<Mirror>();
+        emulator.update_mirror(*mirror, 1ULL << selected_memory_module);
 
-        const auto &module_words = snapshot[selected_memory_module];
-        const int total_lines = static_cast<int>(module_words.size()) + 1;
+        const int total_lines = static_cast<int>(mirror->size(selected_memory_module)) + 1;
         const int max_scroll = std::max(0, total_lines - 1);
         memory_hex_scroll_offset = std::clamp(memory_hex_scroll_offset, 0, max_scroll);
 
-        std::vector<std::string> all_lines;
-        all_lines.reserve(static_cast<size_t>(total_lines));
-
-        {
-            std::ostringstream header;
-            header << "[MODULE " << selected_memory_module << " - " << module_name(selected_memory_module) << "]";
-            all_lines.push_back(header.str());
-        }
+        // Only the visible window is formatted, line 0 is the module header.
+        const int visible_lines = 18;
+        const int start_index = std::clamp(memory_hex_scroll_offset, 0, std::max(0, total_lines - visible_lines));
 
-        for (size_t index = 0; index < module_words.size(); ++index)
+        for (int i = start_index; i < total_lines && (i - start_index) < visible_lines; ++i)
         {
             std::ostringstream line;
-            line << std::setw(4) << index << "  " << format_word_value(module_words[index], true)
-                 << "    " << printable_char_preview(module_words[index]);
-            all_lines.push_back(line.str());
+            if (i == 0)
+            {
+                line << "[MODULE " << selected_memory_module << " - " << module_name(selected_memory_module) << "]";
+            }
+            else
+            {
+                const auto word = mirror->word(selected_memory_module, static_cast<size_t>(i - 1));
+                line << std::setw(4) << (i - 1) << "  " << format_word_value(word, true)
+                     << "    " << printable_char_preview(word);
+            }
+            mem_lines.push_back(line.str());
         }
 
-        const int visible_lines = 18;
-        const int start_index = std::clamp(memory_hex_scroll_offset, 0, std::max(0, static_cast<int>(all_lines.size()) - visible_lines));
-
-        for (int i = start_index; i < static_cast<int>(all_lines.size()) && (i - start_index) < visible_lines; ++i)
-            mem_lines.push_back(all_lines[static_cast<size_t>(i)]);
-
         if (mem_lines.size() == 1)
             mem_lines.push_back("NO MEMORY SNAPSHOT AVAILABLE");
 
@@ -1446,16 +1465,36 @@ private:
         SDL_Rect viewport{grid_x, grid_y, grid_w, grid_h};
         SDL_RenderFillRect(renderer, &viewport);
 
-        const auto &gpu_pixels = emulator.get_gpu_framebuffer();
+        const auto gpu_view = emulator.get_gpu_framebuffer_view();
+
+        // RGB565 uploads natively, indexed frames are expanded through the palette into ARGB8888.
+        const Uint32 texture_format = gpu_view.format == FIAT128::GpuPixelFormat::Rgb565 ? SDL_PIXELFORMAT_RGB565 : SDL_PIXELFORMAT_ARGB8888;
+        if (gpu_texture && gpu_texture_format != texture_format)
+        {
+            SDL_DestroyTexture(gpu_texture);
+            gpu_texture = nullptr;
+        }
+
         if (!gpu_texture)
         {
-            gpu_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, gpu_logical_width, gpu_logical_height);
+            gpu_texture = SDL_CreateTexture(renderer, texture_format, SDL_TEXTUREACCESS_STREAMING, gpu_logical_width, gpu_logical_height);
             if (!gpu_texture)
                 throw std::runtime_error(std::string("SDL_CreateTexture failed: ") + SDL_GetError());
+            gpu_texture_format = texture_format;
         }
 
-        if (!gpu_pixels.empty())
-            SDL_UpdateTexture(gpu_texture, nullptr, gpu_pixels.data(), gpu_logical_width * static_cast<int>(sizeof(Uint32)));
+        if (gpu_view.pixels && gpu_view.format == FIAT128::GpuPixelFormat::Indexed8)
+        {
+            const auto *indices = static_cast<const uint8_t *>(gpu_view.pixels);
+            gpu_expanded_pixels.resize(gpu_view.width * gpu_view.height);
+            std::transform(indices, indices + gpu_expanded_pixels.size(), gpu_expanded_pixels.begin(), [&](uint8_t index)
+                           { return (*gpu_view.palette)[index]; });
+            SDL_UpdateTexture(gpu_texture, nullptr, gpu_expanded_pixels.data(), gpu_logical_width * static_cast<int>(sizeof(Uint32)));
+        }
+        else if (gpu_view.pixels)
+        {
+            SDL_UpdateTexture(gpu_texture, nullptr, gpu_view.pixels, static_cast<int>(gpu_view.pitch));
+        }
 
         SDL_RenderCopy(renderer, gpu_texture, nullptr, &viewport);
 
@@ -1611,8 +1650,11 @@ private:
         return true;
     }
 
-    static auto module_name(size_t module) -> std::string
+    auto module_name(size_t module) const -> std::string
     {
+        if (dma_channel && module == *dma_channel)
+            return "DMA";
+
         switch (module)
         {
         case 0:
@@ -1645,13 +1687,18 @@ private:
     SDL_Window *window = nullptr;
     SDL_Renderer *renderer = nullptr;
     SDL_Texture *gpu_texture = nullptr;
+    Uint32 gpu_texture_format = SDL_PIXELFORMAT_ARGB8888;
+    std::vector<Uint32> gpu_expanded_pixels;
 
     int window_width = 1280;
     int window_height = 720;
     bool running = true;
     size_t frame_counter = 0;
     Uint64 animation_start_ticks = 0;
-    size_t last_seen_memory_sequence = 0;
+    FIAT128::MemoryWriteSubscription memory_subscription = 0;
+    // channel of the drawn emulator's DMA controller, labelled in the memory panel
+    std::optional<size_t> dma_channel;
+    std::any memory_mirror; // EmulatorT::MemoryMirror of the emulator being drawn
     UiCommand pending_command = UiCommand::None;
     std::string status_text = "Idle Loop";
     std::deque<std::string> memory_lines;
@@ -49,6 +49,11 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
 
     size_t active_program_index = 0;
 
+    std::shared_ptr<EmulatorType::ConsoleDevice> console;
+    uint64_t console_cursor = 0;
+    std::string console_screen;
+    GuiRenderer renderer(1280, 720);
+
     auto create_loaded_emulator = [&](const ProgramCatalogEntry &entry)
     {
         const std::array<size_t, 4> module_sizes = {
@@ -59,6 +64,11 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
         };
 
         auto emulator = std::make_unique<EmulatorType>(module_sizes);
+        emulator->set_instruction_fusion(true);
+        console = emulator->attach_console(2);
+        console_cursor = 0;
+        console_screen.clear();
+        renderer.attach(*emulator);
         load_program_entry(*emulator, entry);
         return emulator;
     };
@@ -89,49 +99,21 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
     };
 
     auto Emulator = create_loaded_emulator(program_catalog[active_program_index]);
-    GuiRenderer renderer(1280, 720);
     renderer.set_program_entries(program_catalog);
     renderer.set_selected_program_index(active_program_index);
     renderer.set_status_text(program_catalog[active_program_index].display_name);
 
-    auto update_console_from_m2 = [&](EmulatorType &emulator)
+    auto update_console = [&]()
     {
-        auto snapshot = emulator.get_memory_snapshot();
-
-        // M2 is module 2 (console IO)
-        if (snapshot.size() <= 2)
+        // M2 is module 2 (console IO), the screen only takes the stores made since the last frame and is redrawn
+        // when there were any
+        const uint64_t next = console->read_since(console_cursor, console_screen);
+        if (next == console_cursor)
             return;
 
-        const auto &m2_module = snapshot[2];
-
-        // Keep console rendering consistent with memory hex viewer char preview:
-        // one character per word from the low 8 bits.
-        std::string console_text;
-        console_text.reserve(m2_module.size());
-
-        for (size_t i = 0; i < m2_module.size(); ++i)
-        {
-            const auto &word = m2_module[i];
-
-            uint8_t ch = 0;
-            for (int bit = 0; bit < 8; ++bit)
-            {
-                if (word[static_cast<size_t>(bit)])
-                    ch |= static_cast<uint8_t>(1U << bit);
-            }
-
-            if (ch == 10 || ch == 13)
-                console_text.push_back('\n');
-            else if (ch == 0)
-                console_text.push_back(' ');
-            else if (ch >= 32 && ch <= 126)
-                console_text.push_back(static_cast<char>(ch));
-            else
-                console_text.push_back('.');
-        }
-
+        console_cursor = next;
         renderer.console_clear();
-        renderer.console_append_text(console_text);
+        renderer.console_append_text(console_screen);
     };
 
     // Emulator.set_word(0, 0xFFFF00, 1);
@@ -182,6 +164,7 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
         case GuiRenderer::UiCommand::RunInitOnly:
         {
             Emulator = create_loaded_emulator(program_catalog[active_program_index]);
+            renderer.console_clear();
             const bool init_complete = run_init_only(*Emulator);
             renderer.pause_execution();
             pending_steps = 0.0;
@@ -189,7 +172,6 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
                 renderer.set_status_text(program_catalog[active_program_index].display_name + " [INIT READY]");
             else
                 renderer.set_status_text(program_catalog[active_program_index].display_name + " [INIT TIMEOUT]");
-            renderer.console_clear();
             break;
         }
         case GuiRenderer::UiCommand::LoadSelectedProgram:
@@ -253,23 +235,27 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
             pending_steps = 0.0;
         }
 
-        for (int step = 0; step < steps_to_execute; ++step)
+        if (manual_step_requests == 0)
         {
-            const bool trace_step = manual_step_requests > 0;
-
-            size_t before_sp = 0;
-            std::string before_next;
-            if (trace_step)
+            // free running goes by whole instructions so fused pairs are used, a step is one cycle and the cycles an
+            // instruction runs past the budget come out of the next frame. An idle machine returns without stepping
+            if (steps_to_execute > 0)
             {
-                const auto before_states = Emulator->get_cpu_render_state();
-                before_sp = before_states[0].stack_pointer;
-                before_next = before_states[0].current_instruction_detail;
+                const uint64_t ran = Emulator->run_cycles(static_cast<uint64_t>(steps_to_execute));
+                if (ran > static_cast<uint64_t>(steps_to_execute))
+                    pending_steps -= static_cast<double>(ran - static_cast<uint64_t>(steps_to_execute));
             }
+        }
+        else
+        {
+            for (int step = 0; step < steps_to_execute; ++step)
+            {
+                const auto before_states = Emulator->get_cpu_render_state();
+                const size_t before_sp = before_states[0].stack_pointer;
+                const std::string before_next = before_states[0].current_instruction_detail;
 
-            Emulator->run(true);
+                Emulator->run(true);
 
-            if (trace_step)
-            {
                 const auto after_states = Emulator->get_cpu_render_state();
                 const auto &after_cpu0 = after_states[0];
                 std::cout << "[STEP] cpu0 sp:" << before_sp
@@ -281,7 +267,7 @@ int main([[maybe_unused]] int, [[maybe_unused]] char **)
             }
         }
 
-        update_console_from_m2(*Emulator);
+        update_console();
         renderer.draw_frame(*Emulator);
         std::this_thread::sleep_for(std::chrono::milliseconds(16));
         ++i;
@@ -35,6 +35,17 @@ struct ProgramDefinition
     bool mirror_words_to_ram3 = false;
 };
 
+// program words are written for the 128-bit machine, narrower ones keep the low word_size bits
+template <size_t word_size>
+inline auto to_program_word(const std::bitset<128> &value) -> std::bitset<word_size>
+{
+    const std::string bits = value.to_string();
+    if constexpr (word_size >= 128)
+        return std::bitset<word_size>(bits);
+    else
+        return std::bitset<word_size>(bits.substr(128 - word_size));
+}
+
 template <size_t cores, size_t memory_modules, size_t word_size>
 inline auto load_program(FIAT128::Emulator<cores, memory_modules, word_size> &emulator, const ProgramDefinition &program, size_t channel = 0) -> void
 {
@@ -45,10 +56,7 @@ inline auto load_program(FIAT128::Emulator<cores, memory_modules, word_size> &em
     bool has_cpu_instruction = false;
 
     for (size_t module = 0; module < memory_modules; ++module)
-    {
-        for (size_t i = 0; i < static_cast<size_t>(FIAT128::cache_size); ++i)
-            emulator.set_word_in_memory(module, i, std::bitset<word_size>(0));
-    }
+        emulator.fill_range(module, 0, static_cast<size_t>(FIAT128::cache_size), std::bitset<word_size>(0));
 
     for (size_t i = 0; i < static_cast<size_t>(FIAT128::cache_size); ++i)
     {
@@ -61,22 +69,22 @@ inline auto load_program(FIAT128::Emulator<cores, memory_modules, word_size> &em
 
     for (const auto &word : program.words)
     {
-        emulator.set_word_in_memory(0, word.index, std::bitset<word_size>(word.value.to_string()));
+        emulator.set_word_in_memory(0, word.index, to_program_word<word_size>(word.value));
 
         if (program.mirror_words_to_ram1 && memory_modules > 1)
-            emulator.set_word_in_memory(1, word.index, std::bitset<word_size>(word.value.to_string()));
+            emulator.set_word_in_memory(1, word.index, to_program_word<word_size>(word.value));
 
         if (program.mirror_words_to_ram3 && memory_modules > 3)
-            emulator.set_word_in_memory(3, word.index, std::bitset<word_size>(word.value.to_string()));
+            emulator.set_word_in_memory(3, word.index, to_program_word<word_size>(word.value));
 
         if constexpr (use_master_slave_boot)
         {
             if (word.index < static_cast<size_t>(FIAT128::cache_size))
-                emulator.set_word_in_memory(0, slave_rom_base + word.index, std::bitset<word_size>(word.value.to_string()));
+                emulator.set_word_in_memory(0, slave_rom_base + word.index, to_program_word<word_size>(word.value));
         }
         else if (word.index < static_cast<size_t>(FIAT128::cache_size))
         {
-            emulator.set_word_in_cpu(0, static_cast<short>(word.index), word.value);
+            emulator.set_word_in_cpu(0, static_cast<short>(word.index), to_program_word<word_size>(word.value));
         }
     }
 
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <deque>
 #include <iomanip>
 #include <iostream>
@@ -17,16 +18,27 @@ public:
     {
     }
 
+    // Follows the memory writes of emulator from now on, attach before loading a program so its writes show up.
+    template <typename EmulatorT>
+    auto attach(EmulatorT &emulator) -> void
+    {
+        memory_subscription = emulator.subscribe_memory_writes();
+    }
+
     template <typename EmulatorT>
     auto render(EmulatorT &emulator) -> void
     {
         auto cpu_states = emulator.get_cpu_render_state();
-        auto new_events = emulator.get_memory_write_events_since(last_seen_memory_sequence);
+        auto new_events = emulator.poll_memory_writes(memory_subscription);
+        if (!new_events)
+        {
+            attach(emulator);
+            new_events = emulator.poll_memory_writes(memory_subscription);
+        }
 
-        if (!new_events.empty())
+        if (new_events)
         {
-            last_seen_memory_sequence = new_events.back().sequence;
-            for (const auto &event : new_events)
+            for (const auto &event : *new_events)
             {
                 memory_lines.push_back(format_memory_event(event));
                 if (memory_lines.size() > 14)
@@ -84,6 +96,8 @@ private:
             << " CH=" << event.channel
             << " IDX=" << event.index
             << " VAL=" << preview << "...";
+        if (event.count > 1)
+            out << " N=" << event.count;
         return out.str();
     }
 
@@ -149,6 +163,6 @@ private:
     size_t screen_width = 100;
     size_t screen_height = 30;
     size_t frame_index = 0;
-    size_t last_seen_memory_sequence = 0;
+    uint64_t memory_subscription = 0;
     std::deque<std::string> memory_lines;
 };
@@ -53,6 +53,15 @@ namespace
         return word;
     }
 
+    auto make_word_from_lanes(uint32_t lane0, uint32_t lane1, uint32_t lane2, uint32_t lane3) -> std::bitset<128>
+    {
+        std::bitset<128> word;
+        const uint32_t lanes[4] = {lane0, lane1, lane2, lane3};
+        for (size_t lane = 0; lane < 4; ++lane)
+            word |= std::bitset<128>(lanes[lane]) << (lane * 32);
+        return word;
+    }
+
     auto test_opcode_bounds_check_off_by_one() -> TestResult
     {
         std::bitset<8> opcode(Emu::CPU::instruction_count);
@@ -442,6 +451,1197 @@ namespace
             "Expected the GPU shader to fill the framebuffer white and clear RAM3 byte 0 after execution."
         };
     }
+
+    auto test_gpu_shader_extent_bounds_invalidation_and_self_writes() -> TestResult
+    {
+        Emu emu(10000);
+
+        // 3: LOAD R0 [1], 4: LOAD R1 [9], 5: STORE R1 -> [6], 6: HALT, rewritten to PIXEL_STORE R0 by 5, 7: HALT
+        emu.set_word_in_memory(3, 1, std::bitset<128>(0x123456ULL));
+        emu.set_word_in_memory(3, 3, std::bitset<128>(0x0000000100000000ULL));
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x0000000900000100ULL));
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x0000000600000101ULL));
+        emu.set_word_in_memory(3, 6, std::bitset<128>(0x000000000000001FULL));
+        emu.set_word_in_memory(3, 7, std::bitset<128>(0x000000000000001FULL));
+        emu.set_word_in_memory(3, 9, std::bitset<128>(0x0000000000000002ULL));
+
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        // the store lands in the decoded words, so the invocation runs the new instruction at once
+        const auto &framebuffer = emu.get_gpu_framebuffer();
+        const bool self_write_ran = framebuffer.front() == 0xFF123456U && framebuffer.back() == 0xFF123456U &&
+                                    emu.gpu_device->shader_end.load() == 7;
+
+        // the rewritten shader is decoded again, data past its last HALT leaves it alone
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+        const auto generation = emu.gpu_device->shader_write_generation.load();
+        emu.set_word_in_memory(3, 8, std::bitset<128>(0x42ULL));
+        emu.fill_range(3, 100, 200, std::bitset<128>(7));
+        const bool data_kept = emu.gpu_device->shader_write_generation.load() == generation && emu.gpu_device->shader_end.load() == 8;
+
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x000000000000001FULL));
+        const bool code_invalidates = emu.gpu_device->shader_write_generation.load() != generation;
+
+        return {
+            "gpu_shader_extent_bounds_invalidation_and_self_writes",
+            self_write_ran && data_kept && code_invalidates,
+            "Expected only writes up to the shader's last HALT to invalidate it and a shader's store into its own code to run in the same invocation."
+        };
+    }
+
+    auto test_gpu_blit_command_copies_keyed_scaled_rows() -> TestResult
+    {
+        Emu emu(10000);
+
+        // One 3 pixel row, the middle pixel matches the color key.
+        emu.set_word_in_memory(3, 10, make_word_from_lanes(0x112233U, 0x00FF00U, 0x445566U, 0));
+        // src 10, 3x1, at (10, 20), scale 2, key 0x00FF00 enabled.
+        emu.set_word_in_memory(3, 8, make_word_from_lanes(10, 3U | (1U << 16U), 10U | (20U << 16U), 0x00FF00U | (2U << 24U) | (1U << 31U)));
+        emu.set_word_in_memory(3, 2, std::bitset<128>(8));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xB1ULL));
+
+        emu.execute_gpu_shader();
+
+        const auto &framebuffer = emu.get_gpu_framebuffer();
+        auto pixel = [&](size_t x, size_t y)
+        { return framebuffer[y * 400 + x]; };
+
+        const bool ok =
+            pixel(10, 20) == 0xFF112233U && pixel(11, 21) == 0xFF112233U &&
+            pixel(12, 20) == 0xFF000000U && pixel(13, 21) == 0xFF000000U &&
+            pixel(14, 20) == 0xFF445566U && pixel(15, 21) == 0xFF445566U &&
+            pixel(16, 20) == 0xFF000000U && pixel(10, 22) == 0xFF000000U &&
+            emu.bus.read(true, 0, 3, 0).none();
+
+        return {
+            "gpu_blit_command_copies_keyed_scaled_rows",
+            ok,
+            "Expected the 0xB1 blit command to copy a scaled row, skip keyed pixels and clear the control byte."
+        };
+    }
+
+    auto test_gpu_shader_cache_reuses_unchanged_shader() -> TestResult
+    {
+        Emu emu(10000);
+
+        emu.set_word_in_memory(3, 1, std::bitset<128>(0x123456ULL));
+        emu.set_word_in_memory(3, 3, std::bitset<128>(0x0000000100000000ULL));
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x0000000000000002ULL));
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x000000000000001FULL));
+
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        const auto after_rearm = emu.get_gpu_shader_cache_stats();
+
+        // Rewriting the same words invalidates the active shader but hits the content hash.
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x000000000000001FULL));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        const auto after_rewrite = emu.get_gpu_shader_cache_stats();
+
+        // A different shader is a miss and still renders correctly.
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x000000000000001FULL));
+        emu.set_word_in_memory(3, 1, std::bitset<128>(0x00FF00ULL));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        const auto after_change = emu.get_gpu_shader_cache_stats();
+        const auto &framebuffer = emu.get_gpu_framebuffer();
+
+        const bool ok =
+            after_rearm.misses == 1 && after_rearm.hits == 1 &&
+            after_rewrite.misses == 1 && after_rewrite.hits == 2 &&
+            after_change.misses == 2 && after_change.entries == 2 &&
+            framebuffer.front() == 0xFF123456U;
+
+        return {
+            "gpu_shader_cache_reuses_unchanged_shader",
+            ok,
+            "Expected re-armed and rewritten-but-identical shaders to hit the cache and changed shaders to miss."
+        };
+    }
+
+    auto test_gpu_compact_framebuffer_formats() -> TestResult
+    {
+        Emu emu(10000);
+
+        emu.set_word_in_memory(3, 3, std::bitset<128>(0x0000000100000000ULL));
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x0000000000000002ULL));
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x000000000000001FULL));
+
+        // RGB565: white stays white after expansion.
+        emu.set_word_in_memory(3, 1, std::bitset<128>(0xFFFFFFULL));
+        emu.set_word_in_memory(3, 2, make_word_from_lanes(0, 1, 0, 0));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        std::vector<uint32_t> resolved;
+        emu.resolve_gpu_framebuffer(resolved);
+        const auto rgb565_view = emu.get_gpu_framebuffer_view();
+        const bool rgb565_ok =
+            rgb565_view.format == FIAT128::GpuPixelFormat::Rgb565 &&
+            rgb565_view.pitch == 400 * sizeof(uint16_t) &&
+            static_cast<const uint16_t *>(rgb565_view.pixels)[1234] == 0xFFFFU &&
+            emu.get_gpu_framebuffer()[1234] == 0xFFFFFFFFU && resolved[1234] == 0xFFFFFFFFU;
+
+        // Indexed8: palette at word 100, entry 5 lives in word 101 lane 1.
+        emu.set_word_in_memory(3, 101, make_word_from_lanes(0, 0x00FF00U, 0, 0));
+        emu.set_word_in_memory(3, 1, std::bitset<128>(5));
+        emu.set_word_in_memory(3, 2, make_word_from_lanes(0, 2, 100, 0));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+
+        emu.resolve_gpu_framebuffer(resolved);
+        const auto indexed_view = emu.get_gpu_framebuffer_view();
+        const bool indexed_ok =
+            indexed_view.format == FIAT128::GpuPixelFormat::Indexed8 &&
+            static_cast<const uint8_t *>(indexed_view.pixels)[4321] == 5 &&
+            indexed_view.palette && (*indexed_view.palette)[5] == 0xFF00FF00U &&
+            emu.get_gpu_framebuffer()[4321] == 0xFF00FF00U && resolved.size() == 400 * 600 && resolved[4321] == 0xFF00FF00U;
+
+        return {
+            "gpu_compact_framebuffer_formats",
+            rgb565_ok && indexed_ok,
+            "Expected RGB565 and indexed framebuffers to store compact pixels and expand to the right ARGB colors."
+        };
+    }
+
+    auto test_gpu_depth_test_and_blend_modes() -> TestResult
+    {
+        Emu emu(10000);
+
+        // load r0 <- [100], load r1 <- [101], pixel_store_depth r0 at depth r1, halt
+        emu.set_word_in_memory(3, 3, std::bitset<128>(0x0000006400000000ULL));
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x0000006500000100ULL));
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x0000000000010029ULL));
+        emu.set_word_in_memory(3, 6, std::bitset<128>(0x000000000000001FULL));
+
+        auto draw = [&](uint32_t color, uint32_t depth, uint32_t raster)
+        {
+            emu.set_word_in_memory(3, 100, std::bitset<128>(color));
+            emu.set_word_in_memory(3, 101, std::bitset<128>(depth));
+            emu.set_word_in_memory(3, 2, make_word_from_lanes(0, 0, 0, raster));
+            emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+            emu.execute_gpu_shader();
+            return emu.get_gpu_framebuffer()[777];
+        };
+
+        const uint32_t near = draw(0x0000FFU, 50, 0x300);
+        const uint32_t rejected = draw(0xFF0000U, 80, 0x102);
+        const uint32_t added = draw(0xFF0000U, 20, 0x102);
+        const uint32_t blended = draw(0x80FFFFFFU, 90, 0x001);
+
+        return {
+            "gpu_depth_test_and_blend_modes",
+            near == 0xFF0000FFU && rejected == 0xFF0000FFU && added == 0xFFFF00FFU && blended == 0xFFFF80FFU,
+            "Expected farther fragments to be rejected and additive/alpha blending to combine with the framebuffer."
+        };
+    }
+
+    auto test_gpu_doorbell_rings_only_on_command_writes() -> TestResult
+    {
+        Emu emu(10000);
+
+        emu.set_word_in_memory(3, 1, std::bitset<128>(0x123456ULL));
+        const bool quiet_after_data = !emu.has_pending_gpu_command();
+
+        // A command byte that was written behind the bus's back is not serviced.
+        emu.memory[3].write(0, std::bitset<128>(0xFFULL));
+        emu.execute_gpu_shader();
+        const bool ignored_without_doorbell = emu.bus.read(true, 0, 3, 0).to_ullong() == 0xFFULL;
+
+        emu.set_word_in_memory(3, 3, std::bitset<128>(0x0000000100000000ULL));
+        emu.set_word_in_memory(3, 4, std::bitset<128>(0x0000000000000002ULL));
+        emu.set_word_in_memory(3, 5, std::bitset<128>(0x000000000000001FULL));
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xFFULL));
+        const bool rang = emu.has_pending_gpu_command();
+        emu.execute_gpu_shader();
+
+        return {
+            "gpu_doorbell_rings_only_on_command_writes",
+            quiet_after_data && ignored_without_doorbell && rang &&
+                !emu.has_pending_gpu_command() &&
+                emu.bus.read(true, 0, 3, 0).none() &&
+                emu.get_gpu_framebuffer()[42] == 0xFF123456U,
+            "Expected only command writes to word 0 to ring the GPU doorbell and the dispatch to consume it."
+        };
+    }
+
+    auto test_bus_devices_hook_reads_and_writes() -> TestResult
+    {
+        struct Probe : Emu::Device
+        {
+            auto on_read(size_t, size_t index, std::bitset<128> &value) -> void override
+            {
+                if (index == 7)
+                    value = std::bitset<128>(0xABCDULL);
+            }
+
+            auto on_write(size_t, size_t index, const std::bitset<128> &, size_t count) -> void override
+            {
+                writes.push_back({index, count});
+            }
+
+            std::vector<std::pair<size_t, size_t>> writes;
+        };
+
+        Emu emu(10000);
+        auto probe = std::make_shared<Probe>();
+        emu.attach_device(1, probe);
+
+        emu.set_word_in_memory(1, 5, std::bitset<128>(1));
+        emu.fill_range(1, 10, 4, std::bitset<128>(2));
+        emu.set_word_in_memory(0, 5, std::bitset<128>(3));
+        const bool patched = emu.bus.read(true, 0, 1, 7).to_ullong() == 0xABCDULL &&
+                             emu.read_range(1, 6, 2)[1].to_ullong() == 0xABCDULL &&
+                             emu.memory[1].read(7).none();
+
+        emu.attach_device(1, nullptr);
+        emu.set_word_in_memory(1, 6, std::bitset<128>(4));
+        const bool detached = probe->writes.size() == 2 && emu.bus.read(true, 0, 1, 7).none();
+
+        return {
+            "bus_devices_hook_reads_and_writes",
+            patched && detached &&
+                probe->writes[0] == std::make_pair(size_t(5), size_t(1)) &&
+                probe->writes[1] == std::make_pair(size_t(10), size_t(4)),
+            "Expected an attached device to see writes on its channel only and to be able to patch read values."
+        };
+    }
+
+    auto test_console_device_keeps_positions_and_streams_new_characters() -> TestResult
+    {
+        Emu emu(10000);
+        auto console = emu.attach_console(2);
+
+        emu.set_word_in_memory(2, 0, std::bitset<128>('H'));
+        emu.set_word_in_memory(2, 1, std::bitset<128>('I'));
+        emu.set_word_in_memory(2, 2, std::bitset<128>(13));
+
+        std::string screen;
+        uint64_t cursor = console->read_since(0, screen);
+        const bool first = screen.size() == 10000 && screen.compare(0, 4, "HI\n ") == 0;
+
+        // an overwrite replaces the character in place and a clear blanks it
+        emu.set_word_in_memory(2, 0, std::bitset<128>('O'));
+        emu.set_word_in_memory(2, 1, std::bitset<128>(0));
+        emu.write_range(2, 3, {std::bitset<128>('O'), std::bitset<128>('K'), std::bitset<128>(7)});
+        std::ostringstream sink;
+        console->write_to(sink, cursor);
+        cursor = console->read_since(cursor, screen);
+        const bool updated = screen.compare(0, 7, "O \nOK. ") == 0;
+
+        emu.fill_range(2, 0, 10000, std::bitset<128>(0));
+        cursor = console->read_since(cursor, screen);
+        const bool cleared = screen == std::string(10000, ' ');
+
+        std::string idle = screen;
+        console->read_since(cursor, idle);
+
+        return {
+            "console_device_keeps_positions_and_streams_new_characters",
+            first && updated && cleared && idle == screen && sink.str() == "OOK.",
+            "Expected the console screen to follow overwrites and clears by position and the headless sink to print new characters in order."
+        };
+    }
+
+    auto test_watchpoints_record_matching_accesses_only() -> TestResult
+    {
+        Emu emu(10000);
+
+        emu.set_word_in_memory(1, 4, std::bitset<128>(1));
+        const bool idle = !emu.bus.watched_reads.load() && !emu.bus.watched_writes.load();
+
+        const auto writes = emu.add_watchpoint({1, 8, 15, FIAT128::WatchAccess::Write});
+        const auto reads = emu.add_watchpoint({1, 20, 20, FIAT128::WatchAccess::Read});
+        const bool rejected = emu.add_watchpoint({99, 0, 0, FIAT128::WatchAccess::Write}) == 0;
+
+        emu.set_word_in_memory(1, 4, std::bitset<128>(2));
+        emu.set_word_in_memory(0, 10, std::bitset<128>(3));
+        emu.set_word_in_memory(1, 10, std::bitset<128>(4));
+        emu.fill_range(1, 0, 9, std::bitset<128>(5));
+        emu.bus.read(true, 0, 1, 10);
+        emu.bus.read(true, 0, 1, 20);
+
+        std::vector<FIAT128::WatchHit> hits;
+        const uint64_t cursor = emu.collect_watch_hits(0, hits);
+
+        emu.remove_watchpoint(writes);
+        emu.remove_watchpoint(reads);
+        emu.set_word_in_memory(1, 10, std::bitset<128>(6));
+        std::vector<FIAT128::WatchHit> after;
+        emu.collect_watch_hits(cursor, after);
+
+        return {
+            "watchpoints_record_matching_accesses_only",
+            idle && rejected && hits.size() == 3 && after.empty() &&
+                hits[0].watchpoint == writes && hits[0].index == 10 && hits[0].access == FIAT128::WatchAccess::Write &&
+                hits[1].watchpoint == writes && hits[1].index == 0 && hits[1].count == 9 &&
+                hits[2].watchpoint == reads && hits[2].access == FIAT128::WatchAccess::Read &&
+                !emu.bus.watched_reads.load() && !emu.bus.watched_writes.load(),
+            "Expected watchpoints to trace only matching channel, range and access kind, and to disarm on removal."
+        };
+    }
+
+    auto test_dma_moves_words_in_chunks_and_interrupts() -> TestResult
+    {
+        Emu emu(10000);
+        emu.attach_dma(2);
+
+        for (size_t i = 0; i < 600; ++i)
+            emu.set_word_in_memory(0, 100 + i, std::bitset<128>(i + 1));
+
+        auto program = [&](size_t source, size_t destination, size_t length, size_t source_stride, size_t interrupt_cpu)
+        {
+            emu.set_word_in_memory(2, 1, std::bitset<128>(0));
+            emu.set_word_in_memory(2, 2, std::bitset<128>(source));
+            emu.set_word_in_memory(2, 3, std::bitset<128>(1));
+            emu.set_word_in_memory(2, 4, std::bitset<128>(destination));
+            emu.set_word_in_memory(2, 5, std::bitset<128>(length));
+            emu.set_word_in_memory(2, 6, std::bitset<128>(source_stride));
+            emu.set_word_in_memory(2, 0, std::bitset<128>(0xD1U | (interrupt_cpu << 8)));
+        };
+
+        program(100, 0, 600, 1, 2);
+        emu.service_dma();
+        const bool busy = emu.bus.read(true, 0, 2, 8).to_ullong() == 1 && emu.bus.read(true, 0, 2, 9).to_ullong() == 256;
+        emu.service_dma();
+        emu.service_dma();
+        const bool done = emu.bus.read(true, 0, 2, 8).to_ullong() == 2 && emu.bus.read(true, 0, 2, 9).to_ullong() == 600;
+        const bool copied = emu.bus.read(true, 0, 1, 0).to_ullong() == 1 && emu.bus.read(true, 0, 1, 599).to_ullong() == 600;
+        const bool interrupted = emu.cpus[1].interrupt_enabled && !emu.cpus[0].interrupt_enabled;
+
+        program(100, 1000, 3, 10, 0);
+        emu.service_dma();
+        const bool strided = emu.bus.read(true, 0, 1, 1001).to_ullong() == 11 && emu.bus.read(true, 0, 1, 1002).to_ullong() == 21;
+
+        program(100, 9999, 2, 1, 0);
+        emu.service_dma();
+        const bool faulted = emu.bus.read(true, 0, 2, 8).to_ullong() == 3 && emu.bus.read(true, 0, 1, 9999).none();
+
+        // a stride that steps past the end of the source faults as well
+        program(9000, 2000, 3, 0xFFFFFFFFU, 0);
+        emu.service_dma();
+        const bool stride_faulted = emu.bus.read(true, 0, 2, 8).to_ullong() == 3 && emu.bus.read(true, 0, 1, 2000).none();
+
+        return {
+            "dma_moves_words_in_chunks_and_interrupts",
+            busy && done && copied && interrupted && strided && faulted && stride_faulted && emu.get_dma_channel() == 2 &&
+                !Emu(16).get_dma_channel(),
+            "Expected DMA transfers to advance one chunk per service, honor strides, fault out-of-range requests and raise the completion interrupt."
+        };
+    }
+
+    auto test_parallel_int_matches_bus_copy() -> TestResult
+    {
+        using ManyCore = FIAT128::Emulator<8, 4, 128>;
+        constexpr size_t rom_words = static_cast<size_t>(FIAT128::cache_size) * 8 + 100;
+
+        auto fast = std::make_unique<ManyCore>(static_cast<int>(rom_words));
+        auto traced = std::make_unique<ManyCore>(static_cast<int>(rom_words));
+
+        for (size_t i = FIAT128::cache_size; i < rom_words; i += 37)
+        {
+            fast->set_word_in_memory(0, i, std::bitset<128>(i * 3 + 1) << 70);
+            traced->set_word_in_memory(0, i, std::bitset<128>(i * 3 + 1) << 70);
+        }
+
+        // stale cache contents past the end of the ROM must be cleared
+        fast->cpus[8].cache[FIAT128::cache_size - 1] = std::bitset<128>(1);
+
+        // an armed read watchpoint keeps the BUS copy path, its hits name the core that ran INT
+        traced->add_watchpoint({0, FIAT128::cache_size, FIAT128::cache_size, FIAT128::WatchAccess::Read});
+
+        fast->cpus[0].INT();
+        traced->cpus[2].INT();
+
+        std::vector<FIAT128::WatchHit> hits;
+        traced->collect_watch_hits(0, hits);
+        const bool attributed = hits.size() == 1 && hits.front().cpu_id == 2;
+
+        bool same = true;
+        for (size_t core = 1; core <= 8; ++core)
+        {
+            for (size_t i = 0; i < static_cast<size_t>(FIAT128::cache_size); ++i)
+                same = same && fast->cpus[core].cache[i] == traced->cpus[core].cache[i];
+
+            same = same && fast->cpus[core].initialized && fast->cpus[core].flag[ManyCore::CPU::FlagIndex::HALT] == 0;
+        }
+
+        return {
+            "parallel_int_matches_bus_copy",
+            same && attributed && fast->cpus[1].cache[0] == (std::bitset<128>(FIAT128::cache_size * 3 + 1) << 70) &&
+                fast->cpus[8].cache[100].none() && fast->cpus[8].cache[FIAT128::cache_size - 1].none(),
+            "Expected the bulk INT to leave every cache identical to the BUS copy path, zero-filled past the ROM, and BUS reads to name the calling core."
+        };
+    }
+
+    auto test_timer_counts_down_to_a_deadline() -> TestResult
+    {
+        Emu timer_emu(64);
+        auto &cpu = timer_emu.cpus[1];
+        cpu.flag.reset();
+        cpu.load_timer(std::bitset<128>(2));
+        cpu.tick_timer();
+        const bool counting = cpu.timer_value() == std::bitset<128>(1) && !cpu.timer_expired();
+        cpu.tick_timer();
+        const bool expired = cpu.timer_value().none() && cpu.timer_expired();
+        cpu.tick_timer();
+        const bool wrapped = cpu.timer_value().all() && cpu.flag[Emu::CPU::FlagIndex::OVERFLOW] == 1 && !cpu.timer_expired();
+
+        return {
+            "timer_counts_down_to_a_deadline",
+            counting && expired && wrapped,
+            "Expected the timer to count down lazily and wrap with OVERFLOW."
+        };
+    }
+
+    auto test_full_instruction_runs_match_step_mode() -> TestResult
+    {
+        // 13: ADD R1 = R2 + R3, 12: AND R5 = R2 & R3, 11: XOR R4 = R2 ^ R3, 10: HLT
+        auto make = []()
+        {
+            auto emu = std::make_unique<Emu>(64);
+            emu->set_instruction_in_cpu(0, 13, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R3);
+            emu->set_instruction_in_cpu(0, 12, FIAT128::InstructionType::AND, FIAT128::RegisterIndex::R5, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R3);
+            emu->set_instruction_in_cpu(0, 11, FIAT128::InstructionType::XOR, FIAT128::RegisterIndex::R4, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R3);
+            emu->set_instruction_in_cpu(0, 10, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_cpu_entry_point(0, 13);
+            emu->cpus[0].reg[2] = std::bitset<128>(1);
+            emu->cpus[0].reg[3] = std::bitset<128>(2);
+            return emu;
+        };
+
+        auto stepped = make();
+        auto whole = make();
+
+        int stepped_calls = 0;
+        int whole_calls = 0;
+        for (; stepped_calls < 100 && !stepped->get_cpu_render_state()[0].halted; ++stepped_calls)
+            stepped->run(true);
+        for (; whole_calls < 100 && !whole->get_cpu_render_state()[0].halted; ++whole_calls)
+            whole->run(false);
+
+        // every instruction runs, one per run(false) call, on the same two cycles as in step mode
+        const auto &cpu = whole->cpus[0];
+        return {
+            "full_instruction_runs_match_step_mode",
+            whole_calls == 4 && stepped_calls == 8 && cpu.total_cpu_cycles == stepped->cpus[0].total_cpu_cycles &&
+                cpu.stack_pointer == stepped->cpus[0].stack_pointer && cpu.stack_pointer.to_ulong() == 9 &&
+                cpu.reg[1].to_ullong() == 3 && cpu.reg[4].to_ullong() == 3,
+            "Expected run(false) to run one whole instruction per call without skipping the next one or counting an extra cycle."
+        };
+    }
+
+    auto test_halted_cores_are_skipped_and_idle_runs_return() -> TestResult
+    {
+        Emu emu(10000);
+        const bool boot_set = emu.bus.active_cores.count() == 1 && emu.bus.active_cores.test(0);
+
+        emu.set_cpu_entry_point(1, 5);
+        const bool entry_wakes = emu.bus.active_cores.test(1);
+
+        emu.set_cpu_halt_state(0, true);
+        emu.set_cpu_halt_state(1, true);
+        const auto cycles = emu.cpus[1].total_cpu_cycles;
+        const bool idle = emu.is_idle() && emu.run_steps(100, true) == 0 && emu.cpus[1].total_cpu_cycles == cycles;
+
+        // host writes that ring the GPU doorbell keep the machine busy until the command is serviced
+        emu.set_word_in_memory(3, 0, std::bitset<128>(0xB1U));
+        const bool gpu_busy = !emu.is_idle() && emu.run_steps(100, true) == 1 && emu.is_idle();
+
+        emu.cpus[0].INT();
+        const bool int_wakes = emu.bus.active_cores.test(1) && emu.bus.active_cores.test(2) && !emu.is_idle();
+
+        return {
+            "halted_cores_are_skipped_and_idle_runs_return",
+            boot_set && entry_wakes && idle && gpu_busy && int_wakes,
+            "Expected the active-core set to follow HALT changes and run_steps to return at once on an idle machine."
+        };
+    }
+
+    auto test_spin_loop_parks_until_its_word_is_written() -> TestResult
+    {
+        Emu emu(10000);
+
+        // 10: LDA R1 M1 5, 9: BIZ R2 (exit to 4), 8: BUN R3 (back to 10), 4: HLT
+        emu.set_memory_instruction_in_cpu(0, 10, FIAT128::InstructionType::LDA, FIAT128::RegisterIndex::R1, 1, 5);
+        emu.set_instruction_in_cpu(0, 9, FIAT128::InstructionType::BIZ, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_instruction_in_cpu(0, 8, FIAT128::InstructionType::BUN, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_instruction_in_cpu(0, 4, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_word_in_memory(1, 5, std::bitset<128>(7));
+        emu.set_cpu_entry_point(0, 10);
+        emu.cpus[0].reg[2] = std::bitset<128>(5);
+        emu.cpus[0].reg[3] = std::bitset<128>(11);
+        emu.set_core_parking(true);
+
+        const auto start = emu.cpus[0].total_cpu_cycles;
+        for (int i = 0; i < 12; ++i)
+            emu.run(false);
+        const bool parked = emu.cpus[0].parked && emu.cpus[0].park_period == 6;
+
+        const size_t ran = emu.run_steps(100000, false);
+        const bool counted = ran == 100000 && emu.cpus[0].parked && emu.cpus[0].total_cpu_cycles == start + 2 * (12 + 100000);
+
+        // a write elsewhere in the module does not wake the core, a write to the polled word does
+        emu.set_word_in_memory(1, 6, std::bitset<128>(0));
+        emu.run_steps(10, false);
+        const bool still_parked = emu.cpus[0].parked;
+
+        emu.set_word_in_memory(1, 5, std::bitset<128>(0));
+        emu.run_steps(20, false);
+        const bool woken = !emu.cpus[0].parked && emu.cpus[0].is_halted() && emu.cpus[0].reg[1].none();
+
+        // rewriting the loop in the cache wakes the core as well, the new code runs from the next iteration
+        emu.set_word_in_memory(1, 5, std::bitset<128>(7));
+        emu.set_cpu_entry_point(0, 10);
+        emu.run_steps(12, false);
+        const bool parked_again = emu.cpus[0].parked;
+
+        emu.set_instruction_in_cpu(0, 8, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.run_steps(20, false);
+        const bool rewritten = !emu.cpus[0].parked && emu.cpus[0].is_halted() && emu.cpus[0].reg[1] == std::bitset<128>(7);
+
+        return {
+            "spin_loop_parks_until_its_word_is_written",
+            parked && counted && still_parked && woken && parked_again && rewritten,
+            "Expected a side-effect free polling loop to park, keep counting cycles and resume once its word or its code is written."
+        };
+    }
+
+    auto test_parked_core_woken_mid_iteration_keeps_cycles() -> TestResult
+    {
+        // 10: ADD R5 R5 R0, 9: LDA R1 M1 5, 8: BIZ R2 (exit to 4), 7: BUN R3 (back to 10), 4: HLT
+        const auto halt_cycle = [](size_t write_after, bool allow_parking, bool &was_parked)
+        {
+            Emu emu(10000);
+            emu.set_instruction_in_cpu(0, 10, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R5, FIAT128::RegisterIndex::R5, FIAT128::RegisterIndex::R0);
+            emu.set_memory_instruction_in_cpu(0, 9, FIAT128::InstructionType::LDA, FIAT128::RegisterIndex::R1, 1, 5);
+            emu.set_instruction_in_cpu(0, 8, FIAT128::InstructionType::BIZ, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu.set_instruction_in_cpu(0, 7, FIAT128::InstructionType::BUN, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu.set_instruction_in_cpu(0, 4, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu.set_word_in_memory(1, 5, std::bitset<128>(7));
+            emu.set_cpu_entry_point(0, 10);
+            emu.cpus[0].reg[2] = std::bitset<128>(5);
+            emu.cpus[0].reg[3] = std::bitset<128>(11);
+            emu.cpus[0].reg[5] = std::bitset<128>(1);
+            emu.set_core_parking(true);
+
+            // a device that observes reads keeps the core stepping
+            if (!allow_parking)
+                emu.attach_device(1, std::make_shared<Emu::Device>());
+
+            for (size_t i = 0; i < write_after; ++i)
+                emu.run(true);
+            was_parked = emu.cpus[0].parked;
+
+            emu.set_word_in_memory(1, 5, std::bitset<128>(0));
+            for (int i = 0; i < 1000 && !emu.cpus[0].is_halted(); ++i)
+                emu.run(true);
+
+            return emu.cpus[0].is_halted() ? emu.cpus[0].total_cpu_cycles : -1;
+        };
+
+        // one write per cycle of an 8-cycle iteration, before, at and after the LDA
+        bool matched = true;
+        bool parked = true;
+        for (size_t write_after = 40; write_after < 48; ++write_after)
+        {
+            bool parking_run_parked = false;
+            bool stepping_run_parked = false;
+            const auto parking = halt_cycle(write_after, true, parking_run_parked);
+            const auto stepping = halt_cycle(write_after, false, stepping_run_parked);
+
+            matched = matched && parking > 0 && parking == stepping;
+            parked = parked && parking_run_parked && !stepping_run_parked;
+        }
+
+        return {
+            "parked_core_woken_mid_iteration_keeps_cycles",
+            matched && parked,
+            "Expected a parked core woken mid-iteration to halt on the same cycle as a core that stepped the loop."
+        };
+    }
+
+    auto test_alu_flags_are_folded_when_read() -> TestResult
+    {
+        Emu emu(10000);
+        auto &cpu = emu.cpus[0];
+
+        // R1 ^ R1 is zero, R1 & R2 is non-zero afterwards, ZERO stays set because flags are sticky
+        cpu.reg[1] = std::bitset<128>(6);
+        cpu.reg[2] = std::bitset<128>(3);
+        cpu.reg[4] = std::bitset<128>(9);
+        cpu.current_instruction.dest = FIAT128::R3;
+        cpu.current_instruction.src_1 = FIAT128::R1;
+        cpu.current_instruction.src_2 = FIAT128::R1;
+        cpu.XOR();
+        const bool deferred = cpu.pending_flags != 0 && !cpu.flag.test(Emu::CPU::FlagIndex::ZERO) &&
+                              cpu.current_flags().test(Emu::CPU::FlagIndex::ZERO);
+        cpu.current_instruction.src_2 = FIAT128::R2;
+        cpu.AND();
+
+        // back-to-back ALU ops accumulate into the pending bits, flag stays untouched until the branch
+        const bool accumulated = cpu.flag.none() && cpu.current_flags().test(Emu::CPU::FlagIndex::ZERO) &&
+                                 !cpu.current_flags().test(Emu::CPU::FlagIndex::SIGN);
+
+        cpu.current_instruction.dest = FIAT128::R4;
+        cpu.BIZ();
+        const bool branched = cpu.stack_pointer.to_ulong() == 9 && cpu.pending_flags == 0 && cpu.flag.test(Emu::CPU::FlagIndex::ZERO);
+
+        // a pending negative result must not override the SIGN decided by GRT
+        cpu.reg[5].reset();
+        cpu.reg[5].set(127);
+        cpu.current_instruction.dest = FIAT128::R5;
+        cpu.current_instruction.src_1 = FIAT128::R5;
+        cpu.MOV();
+        cpu.current_instruction.src_1 = FIAT128::R1;
+        cpu.current_instruction.src_2 = FIAT128::R2;
+        cpu.GRT();
+        const bool compared = !cpu.flag.test(Emu::CPU::FlagIndex::SIGN) && !cpu.current_flags().test(Emu::CPU::FlagIndex::SIGN);
+
+        return {
+            "alu_flags_are_folded_when_read",
+            deferred && accumulated && branched && compared,
+            "Expected ALU results to defer ZERO/SIGN until a branch or compare reads them, with sticky semantics kept."
+        };
+    }
+
+    template <size_t word_size>
+    auto run_narrow_word_program() -> bool
+    {
+        using Narrow = FIAT128::Emulator<0, 2, word_size>;
+        using Flags = typename Narrow::CPU::FlagIndex;
+        Narrow emu(64);
+
+        // 3: ADD R3 = R1 + R2 (carries out), 2: GRT R4 vs R5, 1: HLT
+        ProgramDefinition program;
+        program.words = {{20, make_word_from_lanes(0x1234U, 0x5678U, 0x9ABCU, 0xDEF0U)}};
+        program.instructions = {
+            {3, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2},
+            {2, FIAT128::InstructionType::GRT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R4, FIAT128::RegisterIndex::R5},
+            {1, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0},
+        };
+        load_program(emu, program);
+
+        auto &cpu = emu.cpus[0];
+        cpu.reg[1].set();
+        cpu.reg[2] = std::bitset<word_size>(1);
+        cpu.reg[4] = std::bitset<word_size>(5);
+        cpu.reg[5] = std::bitset<word_size>(9);
+        const bool decoded = cpu.next_instruction_name() == "ADD";
+        emu.run_steps(10, false);
+
+        std::bitset<word_size> counter(41);
+        cpu.increment(counter);
+
+        // byte-encoded instructions land in the top 32 bits of a narrow word too
+        emu.set_instruction_in_memory(1, 5, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R3);
+        const bool encoded = (emu.memory[1].read(5) >> (word_size - 32)).to_ullong() == ((static_cast<uint64_t>(FIAT128::InstructionType::ADD) << 24) | 0x010203U);
+        const bool lanes = emu.memory[1].lane(5, word_size / 32 - 1) == ((static_cast<uint32_t>(FIAT128::InstructionType::ADD) << 24) | 0x010203U) &&
+                           emu.memory[1].lane(5, 3) == 0;
+
+        const auto flags = cpu.current_flags();
+        return decoded && encoded && lanes && cpu.is_halted() && cpu.reg[3].none() && flags.test(Flags::OVERFLOW) && flags.test(Flags::ZERO) &&
+               flags.test(Flags::SIGN) && counter.to_ullong() == 42 && cpu.cache[20].to_ullong() == (word_size == 32 ? 0x1234ULL : 0x567800001234ULL);
+    }
+
+    auto test_narrow_word_sizes_run_native_paths() -> TestResult
+    {
+        const bool ok64 = run_narrow_word_program<64>();
+        const bool ok32 = run_narrow_word_program<32>();
+
+        return {
+            "narrow_word_sizes_run_native_paths",
+            ok64 && ok32,
+            "Expected 64-bit and 32-bit emulators to load, decode and execute with carries and compares on native words, and read absent lanes as 0."
+        };
+    }
+
+    auto test_counted_loop_fast_forward_matches_stepping() -> TestResult
+    {
+        // 12: ADD R3 += R1, 11: ADD R2 += R5 (-1), 10: GRT R4 R2, 9: BIN R6 (back to 12 while R2 > 0), 8: HLT
+        auto make = [](bool accelerate)
+        {
+            auto emu = std::make_unique<Emu>(10000);
+            emu->set_instruction_in_cpu(0, 12, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R1);
+            emu->set_instruction_in_cpu(0, 11, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R2, FIAT128::RegisterIndex::R5);
+            emu->set_instruction_in_cpu(0, 10, FIAT128::InstructionType::GRT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R4, FIAT128::RegisterIndex::R2);
+            emu->set_instruction_in_cpu(0, 9, FIAT128::InstructionType::BNZ, FIAT128::RegisterIndex::R6, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_instruction_in_cpu(0, 8, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_cpu_entry_point(0, 12);
+            emu->cpus[0].reg[1] = std::bitset<128>(7);
+            emu->cpus[0].reg[2] = std::bitset<128>(50000);
+            emu->cpus[0].reg[5].set();
+            emu->cpus[0].reg[6] = std::bitset<128>(13);
+            emu->cpus[0].load_timer(std::bitset<128>(500001));
+            emu->set_loop_acceleration(accelerate);
+            return emu;
+        };
+
+        auto stepped = make(false);
+        auto fast = make(true);
+
+        size_t stepped_runs = 0;
+        while (!stepped->cpus[0].is_halted() && stepped_runs < 300000)
+        {
+            stepped->run(false);
+            ++stepped_runs;
+        }
+
+        size_t fast_runs = 0;
+        while (!fast->cpus[0].is_halted() && fast_runs < 300000)
+        {
+            fast->run(false);
+            ++fast_runs;
+        }
+
+        const auto &a = stepped->cpus[0];
+        const auto &b = fast->cpus[0];
+        const bool same = a.is_halted() && b.is_halted() && a.reg[3] == std::bitset<128>(350000) &&
+                          std::equal(std::begin(a.reg), std::end(a.reg), std::begin(b.reg)) && a.current_flags() == b.current_flags() &&
+                          a.total_cpu_cycles == b.total_cpu_cycles && a.timer_ticks == b.timer_ticks && a.timer_deadline == b.timer_deadline;
+
+        // a DMA transfer that interrupts the core keeps it stepping, so the interrupt lands on the same iteration
+        auto with_dma = [&](bool accelerate)
+        {
+            auto emu = make(accelerate);
+            emu->attach_dma(2);
+            emu->set_word_in_memory(2, 5, std::bitset<128>(5000));
+            emu->set_word_in_memory(2, 0, std::bitset<128>(0xD1U | (1U << 8)));
+            for (int i = 0; i < 30; ++i)
+                emu->run(false);
+            return emu;
+        };
+
+        const auto dma_stepped = with_dma(false);
+        const auto dma_fast = with_dma(true);
+        const bool interrupt_exact = dma_fast->cpus[0].total_cpu_cycles == dma_stepped->cpus[0].total_cpu_cycles &&
+                                     std::equal(std::begin(dma_fast->cpus[0].reg), std::end(dma_fast->cpus[0].reg), std::begin(dma_stepped->cpus[0].reg));
+
+        return {
+            "counted_loop_fast_forward_matches_stepping",
+            same && fast_runs < 100 && interrupt_exact,
+            "Expected a counted ADD/GRT/BIN loop to skip to its last iteration with registers, flags, cycles and timer as if stepped, and to keep stepping while a DMA transfer will interrupt it."
+        };
+    }
+
+    auto test_decoded_slots_follow_cache_rewrites() -> TestResult
+    {
+        Emu emu(10000);
+        auto &cpu = emu.cpus[0];
+
+        // 20: LDA R1 M1 3, 19: STA R1 M1 5, 18: EQL R1 R2, 17: BIZ R3 (to 10), 16: HLT, 10: HLT
+        emu.set_memory_instruction_in_cpu(0, 20, FIAT128::InstructionType::LDA, FIAT128::RegisterIndex::R1, 1, 3);
+        emu.set_memory_instruction_in_cpu(0, 19, FIAT128::InstructionType::STA, FIAT128::RegisterIndex::R1, 1, 5);
+        emu.set_instruction_in_cpu(0, 18, FIAT128::InstructionType::EQL, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2);
+        emu.set_instruction_in_cpu(0, 17, FIAT128::InstructionType::BIZ, FIAT128::RegisterIndex::R3, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_instruction_in_cpu(0, 16, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_instruction_in_cpu(0, 10, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_word_in_memory(1, 3, std::bitset<128>(42));
+        cpu.reg[2] = std::bitset<128>(42);
+        cpu.reg[3] = std::bitset<128>(11);
+        emu.set_cpu_entry_point(0, 20);
+
+        // step mode decodes every fetch on its own and leaves the slots alone
+        auto start = cpu.total_cpu_cycles;
+        for (int i = 0; i < 12; ++i)
+            emu.run(true);
+        const bool stepped = cpu.is_halted() && cpu.stack_pointer.to_ulong() == 9 && cpu.total_cpu_cycles == start + 10 &&
+                             cpu.decoded_cache[20].generation == 0;
+
+        emu.set_cpu_entry_point(0, 20);
+        start = cpu.total_cpu_cycles;
+        emu.run_steps(10, false);
+        const bool decoded = cpu.decoded_cache[20].generation != 0 && cpu.decoded_cache[20].instruction.opcode == &Emu::CPU::LDA &&
+                             cpu.decoded_cache[17].instruction.opcode == &Emu::CPU::BIZ;
+        const bool ran = stepped && cpu.is_halted() && cpu.stack_pointer.to_ulong() == 9 && emu.memory[1].read(5) == std::bitset<128>(42) &&
+                         cpu.total_cpu_cycles == start + 10;
+
+        // the rewritten word is decoded again, the new instruction runs instead of the stale decode
+        emu.set_instruction_in_cpu(0, 17, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+        emu.set_cpu_entry_point(0, 18);
+        emu.run_steps(10, false);
+        const bool rewritten = cpu.decoded_cache[17].instruction.opcode == &Emu::CPU::HLT && cpu.is_halted() && cpu.stack_pointer.to_ulong() == 16;
+
+        return {
+            "decoded_slots_follow_cache_rewrites",
+            decoded && ran && rewritten,
+            "Expected fetches to reuse pre-decoded slots, keep two cycles per instruction and re-decode when the cache word changes."
+        };
+    }
+
+    auto test_fused_pairs_dispatch_once_and_keep_cycles() -> TestResult
+    {
+        // 30: LDA R4 M1 3, 29: STA R4 M1 5, 28: ADD R1 += R2, 27: EQL R1 R3, 26: BIZ R5 (to 20), 25: BUN R6 (to 30),
+        // 20: ADD R7 = R1 + R2, 19: BIN R5, 18: HLT
+        auto make = [](bool fuse)
+        {
+            auto emu = std::make_unique<Emu>(10000);
+            emu->set_memory_instruction_in_cpu(0, 30, FIAT128::InstructionType::LDA, FIAT128::RegisterIndex::R4, 1, 3);
+            emu->set_memory_instruction_in_cpu(0, 29, FIAT128::InstructionType::STA, FIAT128::RegisterIndex::R4, 1, 5);
+            emu->set_instruction_in_cpu(0, 28, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2);
+            emu->set_instruction_in_cpu(0, 27, FIAT128::InstructionType::EQL, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R3);
+            emu->set_instruction_in_cpu(0, 26, FIAT128::InstructionType::BIZ, FIAT128::RegisterIndex::R5, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_instruction_in_cpu(0, 25, FIAT128::InstructionType::BUN, FIAT128::RegisterIndex::R6, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_instruction_in_cpu(0, 20, FIAT128::InstructionType::ADD, FIAT128::RegisterIndex::R7, FIAT128::RegisterIndex::R1, FIAT128::RegisterIndex::R2);
+            emu->set_instruction_in_cpu(0, 19, FIAT128::InstructionType::BNZ, FIAT128::RegisterIndex::R5, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_instruction_in_cpu(0, 18, FIAT128::InstructionType::HLT, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0, FIAT128::RegisterIndex::R0);
+            emu->set_word_in_memory(1, 3, std::bitset<128>(42));
+            emu->set_cpu_entry_point(0, 30);
+            emu->cpus[0].reg[2] = std::bitset<128>(1);
+            emu->cpus[0].reg[3] = std::bitset<128>(5);
+            emu->cpus[0].reg[5] = std::bitset<128>(21);
+            emu->cpus[0].reg[6] = std::bitset<128>(31);
+            emu->set_instruction_fusion(fuse);
+            return emu;
+        };
+
+        auto count_dispatches = [](Emu &emu)
+        {
+            size_t runs = 0;
+            while (!emu.cpus[0].is_halted() && runs < 1000)
+            {
+                emu.run(false);
+                ++runs;
+            }
+            return runs;
+        };
+
+        auto split = make(false);
+        auto fused = make(true);
+        const auto fused_start = fused->cpus[0].total_cpu_cycles;
+        const auto split_runs = count_dispatches(*split);
+        const auto fused_runs = count_dispatches(*fused);
+
+        // a cycle budget runs whole pairs, so it can end past the budget but never splits one
+        auto paced = make(true);
+        const auto overshoot = paced->run_cycles(9);
+        const auto rest = paced->run_cycles(1000);
+        const bool paced_ok = overshoot == 10 && paced->cpus[0].is_halted() &&
+                              overshoot + rest == static_cast<uint64_t>(fused->cpus[0].total_cpu_cycles - fused_start);
+
+        // five iterations of six instructions, the last leaves before BUN, then the tail and HLT; each iteration fuses
+        // LDA/STA and EQL/BIZ, the tail ADD/BIN
+        const auto &a = split->cpus[0];
+        const auto &b = fused->cpus[0];
+        const bool same = a.total_cpu_cycles == b.total_cpu_cycles && a.timer_ticks == b.timer_ticks && a.flag == b.flag &&
+                          a.stack_pointer == b.stack_pointer && std::equal(std::begin(a.reg), std::end(a.reg), std::begin(b.reg)) &&
+                          split->memory[1].read(5) == fused->memory[1].read(5);
+        const bool ok = same && b.is_halted() && b.reg[7].to_ullong() == 6 && fused->memory[1].read(5) == std::bitset<128>(42) &&
+                        split_runs == 32 && fused_runs == 21 && paced_ok;
+
+        return {
+            "fused_pairs_dispatch_once_and_keep_cycles",
+            ok,
+            "Expected fused pairs to take one dispatch each, also under a cycle budget, while cycles, timer, flags, registers and memory match separate dispatch (runs " +
+                std::to_string(split_runs) + " vs " + std::to_string(fused_runs) + ")."
+        };
+    }
+
+    auto test_cpu_hot_state_is_packed_and_cache_is_separate() -> TestResult
+    {
+        Emu emu(10000);
+        const auto &cpu = emu.cpus[1];
+
+        const auto line_of = [](const void *address)
+        { return reinterpret_cast<std::uintptr_t>(address) / 64; };
+        const auto first_line = line_of(&cpu.current_instruction);
+
+        // the control fields sit in the first two lines, the registers start on the next one
+        const bool packed = reinterpret_cast<std::uintptr_t>(&cpu.current_instruction) % 64 == 0 &&
+                            line_of(&cpu.total_cpu_cycles) == first_line && line_of(&cpu.flag) <= first_line + 1 &&
+                            line_of(&cpu.stack_pointer) <= first_line + 1 && line_of(&cpu.accelerate_loops) <= first_line + 1 &&
+                            line_of(&cpu.reg[0]) == first_line + 2;
+
+        const bool separate = cpu.cache.size() == FIAT128::cache_size && reinterpret_cast<std::uintptr_t>(cpu.cache.data()) % 64 == 0 &&
+                              sizeof(Emu::CPU) < FIAT128::cache_size * sizeof(std::bitset<128>) / 8;
+
+        return {
+            "cpu_hot_state_is_packed_and_cache_is_separate",
+            packed && separate,
+            "Expected the per-cycle CPU state in two aligned cache lines ahead of the registers, with the cache allocated apart."
+        };
+    }
+
+    auto test_memory_limbs_are_aligned_and_copyable() -> TestResult
+    {
+        using Memory = Emu::Memory;
+
+        Memory original(8);
+        const auto wide = make_word_from_lanes(0x11111111U, 0x22222222U, 0x33333333U, 0x80000044U);
+        original.write(5, wide);
+
+        Memory copy(original);
+        Memory assigned;
+        assigned = copy;
+
+        const bool aligned = reinterpret_cast<std::uintptr_t>(original.word_limbs(0)) % 64 == 0;
+        const bool round_trip = original.read(5) == wide && original.lane(5, 3) == 0x80000044U && original.read(4).none();
+        const bool copied = copy.size() == 8 && copy.read(5) == wide && assigned.read(5) == wide;
+
+        return {
+            "memory_limbs_are_aligned_and_copyable",
+            aligned && round_trip && copied,
+            "Expected memory words to round-trip through aligned limbs and survive copy construction and assignment."
+        };
+    }
+
+    auto test_range_writes_log_one_coalesced_event() -> TestResult
+    {
+        Emu emu(64);
+        emu.record_memory_writes();
+
+        const size_t before = emu.bus.latest_memory_write_sequence();
+        const auto pattern = make_word_from_lanes(1, 2, 3, 4);
+        emu.fill_range(1, 10, 100, pattern);
+
+        const auto events = emu.get_memory_write_events_since(before);
+        const bool one_event = events.size() == 1 && events.front().index == 10 && events.front().count == 54;
+
+        emu.write_range(1, 62, {std::bitset<128>(7), std::bitset<128>(8), std::bitset<128>(9)});
+        const auto tail = emu.read_range(1, 60, 10);
+
+        const bool values_ok =
+            tail.size() == 4 &&
+            tail[0] == pattern && tail[1] == pattern &&
+            tail[2].to_ullong() == 7 && tail[3].to_ullong() == 8 &&
+            emu.bus.read(true, 0, 1, 9).none();
+
+        return {
+            "range_writes_log_one_coalesced_event",
+            one_event && values_ok,
+            "Expected fill_range/write_range to clip to the module and log a single coalesced event."
+        };
+    }
+
+    auto test_write_event_ring_keeps_newest_entries_across_writers() -> TestResult
+    {
+        Emu emu(64);
+        emu.record_memory_writes();
+
+        std::vector<std::thread> writers;
+        for (size_t writer = 0; writer < 4; ++writer)
+        {
+            writers.emplace_back([&emu, writer]()
+            {
+                for (size_t i = 0; i < 1000; ++i)
+                    emu.bus.write(true, writer, 1, i % 64, std::bitset<128>(i));
+            });
+        }
+
+        for (auto &writer : writers)
+            writer.join();
+
+        const auto events = emu.get_memory_write_events_since(0);
+        bool contiguous = !events.empty() && events.back().sequence == 4000;
+        for (size_t i = 1; i < events.size(); ++i)
+            contiguous = contiguous && events[i].sequence == events[i - 1].sequence + 1;
+
+        const auto newest = emu.get_memory_write_events_since(3990);
+        const size_t dropped = emu.dropped_memory_write_events();
+
+        // entries that were read before they were overwritten are not lost
+        for (size_t i = 0; i < 100; ++i)
+            emu.bus.write(true, 0, 1, i % 64, std::bitset<128>(i));
+
+        return {
+            "write_event_ring_keeps_newest_entries_across_writers",
+            contiguous && events.size() == 512 && dropped == 4000 - 512 && emu.dropped_memory_write_events() == dropped &&
+                newest.size() == 10 && newest.front().sequence == 3991,
+            "Expected the write event ring to keep the newest 512 entries in order and count only the unread rest as dropped."
+        };
+    }
+
+    auto test_memory_write_subscriptions_filter_and_drop() -> TestResult
+    {
+        Emu emu(64);
+        Emu other(64);
+
+        // the legacy log is on until a caller turns it off
+        emu.set_word_in_memory(2, 0, std::bitset<128>(1));
+        const bool logged = emu.latest_memory_write_sequence() == 1;
+        emu.record_memory_writes(false);
+
+        FIAT128::MemoryWriteFilter console;
+        console.channels = 1ULL << 2;
+        console.first_index = 4;
+        console.last_index = 7;
+        const auto console_token = emu.subscribe_memory_writes(console, 4, FIAT128::WriteDropPolicy::DropNewest);
+        const auto gpu_token = emu.subscribe_memory_writes({1ULL << 3, 0, 63, ~0ULL}, 8);
+
+        for (size_t i = 0; i < 64; ++i)
+            emu.set_word_in_memory(3, i, std::bitset<128>(i));
+        for (size_t i = 0; i < 10; ++i)
+            emu.set_word_in_memory(2, i, std::bitset<128>('A' + i));
+        emu.fill_range(2, 6, 20, std::bitset<128>('!'));
+
+        const auto console_events = emu.poll_memory_writes(console_token);
+        const bool console_ok =
+            console_events && console_events->size() == 4 &&
+            console_events->front().index == 4 && console_events->back().index == 7 &&
+            emu.dropped_memory_writes(console_token) == 1;
+
+        const auto gpu_events = emu.poll_memory_writes(gpu_token);
+        const bool gpu_ok =
+            gpu_events && gpu_events->size() == 8 && gpu_events->back().index == 63 &&
+            emu.dropped_memory_writes(gpu_token) == 56 && gpu_events->front().sequence == 57;
+
+        emu.unsubscribe_memory_writes(gpu_token);
+        const bool tokens_ok =
+            console_token != gpu_token &&
+            !emu.poll_memory_writes(gpu_token) &&
+            !other.poll_memory_writes(console_token) &&
+            other.subscribe_memory_writes() > gpu_token &&
+            emu.latest_memory_write_sequence() == 1;
+
+        return {
+            "memory_write_subscriptions_filter_and_drop",
+            logged && console_ok && gpu_ok && tokens_ok,
+            "Expected subscriptions to record only matching writes, honor their drop policy and reject foreign tokens."
+        };
+    }
+
+    auto test_memory_mirror_copies_only_dirty_pages() -> TestResult
+    {
+        Emu emu(2048);
+        Emu::MemoryMirror mirror;
+
+        const bool initial = emu.update_mirror(mirror) == 0b1111 && mirror.size(1) == 2048 && mirror.pages[1].empty();
+        const bool idle = emu.update_mirror(mirror) == 0;
+
+        const uint64_t since = mirror.generations[1];
+        emu.set_word_in_memory(1, 700, std::bitset<128>(77));
+
+        std::vector<Emu::MemoryPageDelta> pages;
+        emu.snapshot_delta(1, since, pages);
+        const bool one_page = pages.size() == 1 && pages.front().first_index == 512 && pages.front().words[188].to_ullong() == 77;
+
+        const bool updated = emu.update_mirror(mirror) == 0b0010 && mirror.word(1, 700).to_ullong() == 77 && mirror.pages[1].size() == 1;
+
+        Emu replacement(2048);
+        const bool refreshed = replacement.update_mirror(mirror) == 0b1111 && mirror.word(1, 700).none();
+
+        return {
+            "memory_mirror_copies_only_dirty_pages",
+            initial && idle && one_page && updated && refreshed,
+            "Expected snapshot_delta to return only written pages and the mirror to refresh fully for another emulator."
+        };
+    }
+
+    auto test_sparse_memory_allocates_pages_on_write() -> TestResult
+    {
+        // 4 GiB of declared RAM in module 1, only the touched pages become resident.
+        const size_t huge = size_t(1) << 28;
+        Emu emu(std::array<size_t, 4>{64, huge, 64, 64});
+
+        // the page directory is allocated table by table, a fresh module holds no tables
+        const auto allocated_tables = [&emu]
+        {
+            return std::count_if(emu.memory[1].tables.begin(), emu.memory[1].tables.end(), [](const auto &table) { return table != nullptr; });
+        };
+        const bool empty = emu.get_memory_resident_pages(1) == 0 && emu.bus.read(true, 0, 1, huge - 1).none() && allocated_tables() == 0;
+
+        emu.set_word_in_memory(1, huge - 1, std::bitset<128>(99));
+        emu.set_word_in_memory(1, 5, std::bitset<128>(0));
+        const bool one_page = emu.get_memory_resident_pages(1) == 1 && emu.bus.read(true, 0, 1, huge - 1).to_ullong() == 99 &&
+                              allocated_tables() == 1;
+
+        // a mirror of the module holds the written page only
+        Emu::MemoryMirror mirror;
+        emu.update_mirror(mirror, 0b0010);
+        const bool mirrored = mirror.size(1) == huge && mirror.pages[1].size() == 1 && mirror.word(1, huge - 1).to_ullong() == 99;
+
+        emu.set_memory_page_limit(1, 2);
+        emu.set_word_in_memory(1, 0, std::bitset<128>(1));
+        emu.set_word_in_memory(1, 1000000, std::bitset<128>(2));
+        const bool limited = emu.get_memory_resident_pages(1) == 2 && emu.bus.read(true, 0, 1, 1000000).none() &&
+                             emu.get_memory_refused_writes(1) == 1;
+
+        // a fill past the limit counts every dropped word, across both pages it straddles
+        emu.fill_range(1, 2000000, 300, std::bitset<128>(3));
+        const bool refused_per_word = emu.get_memory_refused_writes(1) == 301 && emu.bus.read(true, 0, 1, 2000299).none();
+
+        emu.fill_range(1, 0, 256, std::bitset<128>(0));
+        const bool released = emu.get_memory_resident_pages(1) == 1 && emu.bus.read(true, 0, 1, 0).none();
+
+        // a full snapshot copies the resident page only, the released page reaches the mirror as an empty delta and
+        // refused writes into untouched tables leave nothing to send
+        std::vector<Emu::MemoryPageDelta> full;
+        emu.snapshot_delta(1, 0, full);
+        std::vector<Emu::MemoryPageDelta> incremental;
+        emu.snapshot_delta(1, mirror.generations[1], incremental);
+        emu.update_mirror(mirror, 0b0010);
+        const bool bounded = full.size() == 1 && full.front().first_index == huge - 256 && full.front().words.size() == 256 &&
+                             incremental.size() == 1 && incremental.front().first_index == 0 && incremental.front().words.empty() &&
+                             mirror.pages[1].size() == 1 && mirror.word(1, 0).none();
+
+        return {
+            "sparse_memory_allocates_pages_on_write",
+            empty && one_page && mirrored && limited && refused_per_word && released && bounded,
+            "Expected sparse modules to allocate pages on first non-zero write, honor and report the page limit and free zeroed pages."
+        };
+    }
+
+    auto test_rom_image_is_shared_and_copied_on_write() -> TestResult
+    {
+        struct Probe : Emu::Device
+        {
+            auto on_write(size_t, size_t, const std::bitset<128> &, size_t) -> void override
+            {
+                ++writes;
+            }
+
+            auto on_reload(size_t channel) -> void override
+            {
+                reloads.push_back(channel);
+            }
+
+            size_t writes = 0;
+            std::vector<size_t> reloads;
+        };
+
+        const auto path = std::filesystem::temp_directory_path() / "fiat128_rom_image_test.rom";
+
+        Emu builder(1024);
+        builder.set_word_in_memory(0, 3, make_word_from_lanes(0xAAAAAAAAU, 0, 0, 0xBBBBBBBBU));
+        builder.set_word_in_memory(0, 1000, std::bitset<128>(42));
+        const bool saved = builder.save_rom_image(0, path);
+
+        const auto image = FIAT128::RomImage::open(path);
+        Emu first(1024);
+        Emu second(1024);
+        auto probe = std::make_shared<Probe>();
+        second.attach_device(0, probe);
+        const bool mapped = image && image->size() == 1024 * 16 && first.map_rom_image(image) && second.map_rom_image(image) &&
+                            probe->writes == 0 && probe->reloads == std::vector<size_t>{0};
+
+        // Four full pages come straight from the mapping, nothing is resident until a write.
+        const bool zero_copy = first.get_memory_resident_pages(0) == 0 &&
+                               first.bus.read(true, 0, 0, 3) == make_word_from_lanes(0xAAAAAAAAU, 0, 0, 0xBBBBBBBBU) &&
+                               second.bus.read(true, 0, 0, 1000).to_ullong() == 42;
+
+        first.set_word_in_memory(0, 1000, std::bitset<128>(7));
+        const bool copied_on_write = first.get_memory_resident_pages(0) == 1 &&
+                                     first.bus.read(true, 0, 0, 1000).to_ullong() == 7 &&
+                                     first.bus.read(true, 0, 0, 1001).none() &&
+                                     second.bus.read(true, 0, 0, 1000).to_ullong() == 42 &&
+                                     FIAT128::RomImage::open(path)->size() == image->size();
+
+        std::filesystem::remove(path);
+
+        return {
+            "rom_image_is_shared_and_copied_on_write",
+            saved && mapped && zero_copy && copied_on_write && !FIAT128::RomImage::open(path),
+            "Expected a mapped ROM image to be shared between emulators and copied only into pages the guest writes."
+        };
+    }
 }
 
 int main()
@@ -461,6 +1661,35 @@ int main()
     results.push_back(test_add_does_not_touch_module_memory());
     results.push_back(test_memory_instruction_uses_module_and_address());
     results.push_back(test_gpu_white_fill_shader_runs_and_clears_start_bit());
+    results.push_back(test_gpu_blit_command_copies_keyed_scaled_rows());
+    results.push_back(test_gpu_shader_cache_reuses_unchanged_shader());
+    results.push_back(test_gpu_shader_extent_bounds_invalidation_and_self_writes());
+    results.push_back(test_gpu_compact_framebuffer_formats());
+    results.push_back(test_gpu_depth_test_and_blend_modes());
+    results.push_back(test_gpu_doorbell_rings_only_on_command_writes());
+    results.push_back(test_bus_devices_hook_reads_and_writes());
+    results.push_back(test_console_device_keeps_positions_and_streams_new_characters());
+    results.push_back(test_watchpoints_record_matching_accesses_only());
+    results.push_back(test_dma_moves_words_in_chunks_and_interrupts());
+    results.push_back(test_parallel_int_matches_bus_copy());
+    results.push_back(test_timer_counts_down_to_a_deadline());
+    results.push_back(test_full_instruction_runs_match_step_mode());
+    results.push_back(test_halted_cores_are_skipped_and_idle_runs_return());
+    results.push_back(test_spin_loop_parks_until_its_word_is_written());
+    results.push_back(test_parked_core_woken_mid_iteration_keeps_cycles());
+    results.push_back(test_alu_flags_are_folded_when_read());
+    results.push_back(test_narrow_word_sizes_run_native_paths());
+    results.push_back(test_counted_loop_fast_forward_matches_stepping());
+    results.push_back(test_decoded_slots_follow_cache_rewrites());
+    results.push_back(test_fused_pairs_dispatch_once_and_keep_cycles());
+    results.push_back(test_cpu_hot_state_is_packed_and_cache_is_separate());
+    results.push_back(test_memory_limbs_are_aligned_and_copyable());
+    results.push_back(test_range_writes_log_one_coalesced_event());
+    results.push_back(test_write_event_ring_keeps_newest_entries_across_writers());
+    results.push_back(test_memory_write_subscriptions_filter_and_drop());
+    results.push_back(test_memory_mirror_copies_only_dirty_pages());
+    results.push_back(test_sparse_memory_allocates_pages_on_write());
+    results.push_back(test_rom_image_is_shared_and_copied_on_write());
 
     int failures = 0;
     for (const auto &r : results)